@@ -3,20 +3,178 @@
 */
 
 #include "Cjt_clusters.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+typedef BinTree < pair<string,double> > Arbol_clu;
+
+/** @brief Marca del principio de las trazas de fusiones, seguida de la versión del formato */
+static const char MARCA_TRAZA[4]={'W','P','G','M'};
+static const int32_t VERSION_TRAZA=1;
+
+/** @brief Marca del principio de los puntos de control, seguida de la versión del formato */
+static const char MARCA_CONTROL[4]={'W','P','G','C'};
+static const int32_t VERSION_CONTROL=1;
+
+template <class T> static void escribe_binario(ostream& f, T x) {
+    f.write(reinterpret_cast<const char*>(&x),sizeof(x));
+}
+
+template <class T> static bool lee_binario(istream& f, T& x) {
+    return bool(f.read(reinterpret_cast<char*>(&x),sizeof(x)));
+}
+
+static Arbol_clu une(const Arbol_clu& x, const Arbol_clu& y, double d) {
+    // Clúster que fusiona x e y a distancia d, con los hijos en orden lexicográfico como en wpgma
+    if (y.value().first<x.value().first) return Arbol_clu(make_pair(y.value().first+x.value().first,d/2),y,x);
+    return Arbol_clu(make_pair(x.value().first+y.value().first,d/2),x,y);
+}
+
+/*
+* Copia del estado de los clústers que se graba en un punto de control.
+*/
+struct Estado_control {
+    int32_t modo, filas;
+    vector<int32_t> fila;
+    vector<Arbol_clu> arbol;
+    vector<double> dist;
+};
+
+struct Cjt_clusters::Escritura_control {
+    mutex m;
+    condition_variable cv;
+    bool en_curso;
+    bool correcta;
+};
+
+static void escribe_arbol(ostream& f, const Arbol_clu& c) {
+    // Preorden: identificador y altura de cada nodo, y sus hijos si no es una hoja
+    escribe_binario(f,int32_t(c.value().first.size()));
+    f.write(c.value().first.data(),c.value().first.size());
+    escribe_binario(f,c.value().second);
+    if (c.value().second!=-1) {
+        escribe_arbol(f,c.left());
+        escribe_arbol(f,c.right());
+    }
+}
+
+static bool lee_arbol(istream& f, long long tam, Arbol_clu& c) {
+    int32_t l;
+    double h;
+    if (not lee_binario(f,l) or l<=0 or l>tam) return false;
+    string id(l,' ');
+    if (not f.read(&id[0],l) or not lee_binario(f,h)) return false;
+    if (h==-1) {
+        c=Arbol_clu(make_pair(id,h));
+        return true;
+    }
+    Arbol_clu x,y;
+    if (not lee_arbol(f,tam,x) or not lee_arbol(f,tam,y)) return false;
+    c=Arbol_clu(make_pair(id,h),x,y);
+    return true;
+}
+
+static bool escribe_control(const string& fichero, const Estado_control& e) {
+    // Se escribe en un archivo temporal que sustituye al anterior cuando está completo
+    string temporal=fichero+".tmp";
+    {
+        ofstream f(temporal.c_str(),ios::binary);
+        if (not f) return false;
+        f.write(MARCA_CONTROL,sizeof(MARCA_CONTROL));
+        escribe_binario(f,VERSION_CONTROL);
+        escribe_binario(f,e.modo);
+        escribe_binario(f,e.filas);
+        escribe_binario(f,int32_t(e.fila.size()));
+        for (int i=0; i<e.fila.size(); ++i) {
+            escribe_binario(f,e.fila[i]);
+            escribe_arbol(f,e.arbol[i]);
+        }
+        f.write(reinterpret_cast<const char*>(e.dist.data()),e.dist.size()*sizeof(double));
+        f.close();
+        if (not f) return false;
+    }
+    return rename(temporal.c_str(),fichero.c_str())==0;
+}
+
+static void hojas(const Arbol_clu& c, double peso, vector<pair<string,double> >& h) {
+    // Hojas de c con su peso en la distancia wpgma (la mitad en cada nivel)
+    if (c.value().second==-1) h.push_back(make_pair(c.value().first,peso));
+    else {
+        hojas(c.left(),peso/2,h);
+        hojas(c.right(),peso/2,h);
+    }
+}
+
+static void alturas(const Arbol_clu& c, map<string,double>& a) {
+    // Altura de cada clúster interno de c
+    if (c.value().second!=-1) {
+        a[c.value().first]=c.value().second;
+        alturas(c.left(),a);
+        alturas(c.right(),a);
+    }
+}
+
+static void cortes(const Arbol_clu& c, double altura, vector<Arbol_clu>& g) {
+    // Subárboles máximos de c con altura <= altura (las hojas tienen altura -1)
+    if (c.value().second<=altura) g.push_back(c);
+    else {
+        cortes(c.left(),altura,g);
+        cortes(c.right(),altura,g);
+    }
+}
+
+static void imprime_hojas(const Arbol_clu& c, ostream& out) {
+    // Especies de c, en el orden del árbol
+    if (c.value().second==-1) out<<' '<<c.value().first;
+    else {
+        imprime_hojas(c.left(),out);
+        imprime_hojas(c.right(),out);
+    }
+}
+
+static bool menor_id(const Arbol_clu& x, const Arbol_clu& y) {
+    return x.value().first<y.value().first;
+}
+
+static size_t bytes_string(const string& s) {
+    // Memoria dinámica de s (ninguna si cabe dentro del propio objeto)
+    const char* o=reinterpret_cast<const char*>(&s);
+    if (s.data()>=o and s.data()<o+sizeof(s)) return 0;
+    return s.capacity()+1;
+}
+
+static size_t bytes_nodos(const Arbol_clu& c) {
+    // Cada nodo se crea con make_shared: el valor, los dos hijos y el bloque de control (contadores y puntero)
+    if (c.empty()) return 0;
+    size_t b=sizeof(pair<string,double>)+2*sizeof(Arbol_clu)+2*sizeof(int)+sizeof(void*)+bytes_string(c.value().first);
+    return b+bytes_nodos(c.left())+bytes_nodos(c.right());
+}
 
 //Constructora y destructora
 
-Cjt_clusters::Cjt_clusters(){}
+Cjt_clusters::Cjt_clusters(){
+    pool=0;
+    inserciones=0;
+    comparaciones=0;
+    distintas=0;
+    pasos_control=0;
+    pasos_desde_control=0;
+}
 
 Cjt_clusters::~Cjt_clusters(){}
 
 
 //Consultoras
 
-void Cjt_clusters::imprime_cluster(const string& id_especie) const{
+void Cjt_clusters::imprime_cluster(const string& id_especie, ostream& out) const{
     // Encuentra el BinTree asociado al identificador y llama al método encargado de imprimirlo
     map<string,BinTree <pair <string,double> > >::const_iterator it = Arbol.find(id_especie);
-    imprime_arbol(it->second);
+    imprime_arbol(it->second,out);
 }
 
 bool Cjt_clusters::existe_cluster(const string& id_especie) const{
@@ -26,44 +184,54 @@ bool Cjt_clusters::existe_cluster(const string& id_especie) const{
 } 
 
 void Cjt_clusters::dist_minima(string& a, string& b, double& d) const {
-    //Esta función encuentra la distancia mínima dentro de la tabla de clústers
-    map<string, map<string,double> >::const_iterator it=Tab_clu.begin();
-    map<string,double>::const_iterator it_sec=it->second.begin();
-    // Inicialización de las variables con los valores de los iteradores iniciales
-    a=it->first;
-    b=it_sec->first;
-    d=it_sec->second;
-    // Inv: los iteradores posteriors a it no han sido visitados.
-    // d es el mínimo de los maps "second" de los elementos entre Tab_clu.begin y el anterior a it, 
-    // a y b son los identificadores que tienen distancia d
-    while (it!=Tab_clu.end()) {
-        // Se inicializa el segundo iterador con el valor del segundo elemento del primer iterador
-        // para la iteración actual
-        it_sec=it->second.begin();
-        // Inv: los iteradores posteriors a it_sec no han sido visitados.
-        // d es el mínimo de los elementos entre it->second.begin y el anterior a it_sec, 
-        // a y b son los identificadores que tienen distancia d
-        while (it_sec!=it->second.end()) {
-            if (it_sec->second<d) { // Se ha encontrado una distancia menor
-                a=it->first;
-                b=it_sec->first;
-                d=it_sec->second;
-            }
-            ++it_sec;
-        }
-        // Post: a, b y d tienen los valores de los clústers a menor distancia desde Tab_clu.begin
-        // hasta el último elemento del it_sec de it (it->second.end()-1)
-        ++it;
-    }
-    // Post: Han sido recorridos y comprobados todos los elementos de la tabla, por tanto, a, b y d tienen 
-    // los valores de los clústers a menor distancia desde el inicio de la tabla hasta Tab_clu.end()-1
+    //Esta función encuentra la distancia mínima dentro de la tabla de clústers.
+    // En caso de empate se escoge el par de identificadores lexicográficamente menor
+    int i,j;
+    Tab_clu.minimo(Nombre,i,j,d,pool);
+    a=Nombre[i];
+    b=Nombre[j];
+}
+
+int Cjt_clusters::raiz(int x) const {
+    while (padre[x]!=x) x=padre[x];
+    return x;
+}
+
+bool Cjt_clusters::cluster_de(const string& id_especie, string& id, int& n, double& h) const {
+    // Las consultas no comprimen caminos, para que se puedan hacer a la vez desde varios hilos
+    unordered_map<string,int>::const_iterator it=hoja.find(id_especie);
+    if (it==hoja.end()) return false;
+    int r=raiz(it->second);
+    id=Nombre[fila_raiz[r]];
+    n=tam[r];
+    h=altura[r];
+    return true;
+}
+
+const string& Cjt_clusters::consultar_fichero_control() const {
+    return fichero_control;
+}
+
+int Cjt_clusters::consultar_pasos_control() const {
+    return pasos_control;
+}
+
+bool Cjt_clusters::control_correcto() const {
+    if (escritura==nullptr) return true;
+    espera_control();
+    unique_lock<mutex> l(escritura->m);
+    return escritura->correcta;
+}
+
+void Cjt_clusters::espera_control() const {
+    if (escritura==nullptr) return;
+    unique_lock<mutex> l(escritura->m);
+    escritura->cv.wait(l,[this]() { return not escritura->en_curso; });
 }
 
 double Cjt_clusters::distancia_cl (const string& a, const string& c) const{
-    // Comprueba si el identificador a es menor que c para buscarlo en la tabla. 
-    if (a<c) return Tab_clu.find(a)->second.find(c)->second; 
-    // Sino, busca en la tabla la distancia de c con a.
-    return Tab_clu.find(c)->second.find(a)->second; 
+    // Busca la distancia entre las filas de los clústers a y c
+    return Tab_clu.consultar(Fila.find(a)->second,Fila.find(c)->second);
 }
 
 bool Cjt_clusters::arbol_vacio() const{
@@ -76,21 +244,106 @@ bool Cjt_clusters::apto_para_wpgma() const{
     return Arbol.size()>1;
 }
 
-int Cjt_clusters::calcula_hijos(const BinTree <pair<string,double> >& c, int& f) const {
-    while (not c.empty()) {
-        if (not c.left.empty()) ++f; 
-        if (not c.right.empty()) ++f; 
-        calcula_hijos(c.left());
-        calcula_hijos(c.right());
+bool Cjt_clusters::arbol_construido() const{
+    return Arbol.size()==1;
+}
+
+const Arbol_clu& Cjt_clusters::arbol_filogenetico() const {
+    return Arbol.begin()->second;
+}
+
+size_t Cjt_clusters::bytes_tabla() const {
+    size_t b=Tab_clu.bytes()+Nombre.capacity()*sizeof(string);
+    for (int i=0; i<Nombre.size(); ++i) b+=bytes_string(Nombre[i]);
+    // Los nodos de Fila: los tres punteros y el color del árbol, y el par
+    for (map<string,int>::const_iterator it=Fila.begin(); it!=Fila.end(); ++it) {
+        b+=4*sizeof(void*)+sizeof(pair<const string,int>)+bytes_string(it->first);
     }
+    return b;
+}
+
+size_t Cjt_clusters::bytes_arbol() const {
+    // Los nodos de los árboles y el índice de pertenencia
+    size_t b=padre.capacity()*sizeof(int)+tam.capacity()*sizeof(int)+altura.capacity()*sizeof(double)+
+             fila_raiz.capacity()*sizeof(int)+hoja_fila.capacity()*sizeof(int)+hoja.bucket_count()*sizeof(void*);
+    for (unordered_map<string,int>::const_iterator it=hoja.begin(); it!=hoja.end(); ++it) {
+        b+=sizeof(void*)+sizeof(size_t)+sizeof(pair<const string,int>)+bytes_string(it->first);
+    }
+    for (map<string,Arbol_clu>::const_iterator it=Arbol.begin(); it!=Arbol.end(); ++it) {
+        b+=4*sizeof(void*)+sizeof(pair<const string,Arbol_clu>)+bytes_string(it->first)+bytes_nodos(it->second);
+    }
+    return b;
+}
+
+double Cjt_clusters::distancia_especie(const Arbol_clu& c, const map<string,int>& fila,
+                                       const Tabla_distancias& t, int fs) const {
+    if (c.value().second==-1) return t.consultar(fs,fila.find(c.value().first)->second);
+    return (distancia_especie(c.left(),fila,t,fs)+distancia_especie(c.right(),fila,t,fs))/2;
 }
 
+double Cjt_clusters::busca_union(const Arbol_clu& c, double altura_padre, const map<string,int>& fila,
+                                 const Tabla_distancias& t, int fs, vector<char>& camino, double& mejor, 
+                                 vector<char>& mejor_camino) const {
+    double d;
+    if (c.value().second==-1) d=t.consultar(fs,fila.find(c.value().first)->second);
+    else {
+        camino.push_back(0);
+        double d_izq=busca_union(c.left(),c.value().second,fila,t,fs,camino,mejor,mejor_camino);
+        camino.back()=1;
+        double d_der=busca_union(c.right(),c.value().second,fila,t,fs,camino,mejor,mejor_camino);
+        camino.pop_back();
+        d=(d_izq+d_der)/2;
+    }
+    if (d/2<=altura_padre and d<mejor) {
+        mejor=d;
+        mejor_camino=camino;
+    }
+    return d;
+}
+
+
 //Modificadoras
 
+int Cjt_clusters::comprime(int x) {
+    int r=raiz(x);
+    // Inv: las hojas del camino anteriores a x ya apuntan a r
+    while (padre[x]!=r) {
+        int p=padre[x];
+        padre[x]=r;
+        x=p;
+    }
+    return r;
+}
+
+int Cjt_clusters::anade_hoja(const string& id) {
+    int h=padre.size();
+    hoja.insert(make_pair(id,h));
+    padre.push_back(h);
+    tam.push_back(1);
+    altura.push_back(-1);
+    fila_raiz.push_back(-1);
+    return h;
+}
+
+void Cjt_clusters::une_filas(int fa, int fb, double h) {
+    // Unión por tamaño: el clúster pequeño cuelga de la raíz del grande
+    int ra=comprime(hoja_fila[fa]);
+    int rb=comprime(hoja_fila[fb]);
+    if (tam[ra]<tam[rb]) swap(ra,rb);
+    padre[rb]=ra;
+    tam[ra]+=tam[rb];
+    altura[ra]=h;
+    fila_raiz[ra]=fa;
+    hoja_fila[fa]=ra;
+    hoja_fila[fb]=-1;
+}
+
 void Cjt_clusters::fusiona_cluster(const string& a, const string& b, const double& d) {
     // Fusiona dos clústers
     map<string, BinTree < pair<string,double> > >::const_iterator it_a=Arbol.find(a);
     map<string, BinTree < pair<string,double> > >::const_iterator it_b=Arbol.find(b);
+    // El nuevo clúster ocupará la fila de a (ver actualiza_tab)
+    une_filas(Fila.find(a)->second,Fila.find(b)->second,d/2);
 
     pair<string,double> aux=pair<string,double> (a+b, d/2);
     BinTree < pair<string,double> > F=BinTree<pair<string,double> >(aux, it_a->second, it_b->second);
@@ -98,7 +351,7 @@ void Cjt_clusters::fusiona_cluster(const string& a, const string& b, const doubl
     Arbol.insert(make_pair(a+b,F));
 }
 
-void Cjt_clusters::ejecuta_paso_wpgma () {
+void Cjt_clusters::ejecuta_paso_wpgma (ostream& out) {
     // Ejecuta un paso del algoritmo wpgma completamente
     string a,b;
     double d;
@@ -109,103 +362,451 @@ void Cjt_clusters::ejecuta_paso_wpgma () {
     // Actualiza la tabla de distancias después de crear el nuevo clúster
     actualiza_tab(a,b);
     // Imprime la tabla de distancias
-    imprime_tab_distancias();
+    imprime_tab_distancias(out);
     // Elimina los árboles fusionados
     Arbol.erase(a);
     Arbol.erase(b);
 }
 
+void Cjt_clusters::ejecuta_paso_wpgma_delta(ostream& out) {
+    // Igual que ejecuta_paso_wpgma, pero solo imprime la fusión y la fila nueva
+    string a,b;
+    double d;
+    dist_minima(a,b,d);
+    fusiona_cluster (a,b,d);
+    actualiza_tab(a,b);
+    Arbol.erase(a);
+    Arbol.erase(b);
+    out<<"fusion: "<<a<<" "<<b<<" ("<<d/2<<")"<<endl;
+    imprime_fila(a+b,out);
+}
+
 void Cjt_clusters::actualiza_tab(const string& a, const string& b) {
-    // Actualiza la tabla de distancias
-    map<string,map<string,double> >::iterator it = Tab_clu.begin();
+    // Actualiza la tabla de distancias: el clúster fusionado ocupa la fila de a, 
+    // con la media de las distancias a a y a b, y la fila de b queda libre
+    int fa=Fila.find(a)->second;
+    int fb=Fila.find(b)->second;
+    Tab_clu.fusiona_filas(fa,fb);
     string id_fusion=a+b;
-    map<string,double> aux;
-    // Inv: it<=Tab_clu.end()
-    // Se han recalculado y añadido las distancias de los elementos anteriores a it.
-    // Las distancias de los elementos posteriores a it no han sido modificadas.
-    while (it!=Tab_clu.end()) {
-        if (it->first != a and it->first != b) {
-            if (it->first < id_fusion) { // el identificador del clúster fusionado será el segundo identificador del map
-                // recalculo de la distancia del elemento del iterador con el nuevo clúster fusionado
-                double d = (distancia_cl(it->first,a) + distancia_cl(it->first,b))/2; 
-                it->second.insert(make_pair(id_fusion,d));
-            }
-            else { // el identificador del clúster fusionado será el primer identificador del map
-                double d = (distancia_cl(a,it->first) + distancia_cl(b,it->first))/2;
-                aux.insert(make_pair(it->first,d));
-            }
-        }
-        ++it;
-    }
-    // Post: se han recalculado todas las distancias de los elementos desde Tab_clu.begin()
-    // hasta Tab_clu.end()-1
-    Tab_clu.erase(Tab_clu.find(a));
-    Tab_clu.erase(Tab_clu.find(b));
-    Tab_clu.insert(make_pair(id_fusion,aux));
-
-    // Inv: it<=Tab_clu.end(). Se han eliminado los elementos anteriores a it relacionados con a o b. 
-    // Las distancias de los elementos posteriores a it no han sido modificadas.
-    // Condición extra para evitar iteraciones innecesarias: el primer elemento de la tabla es menor a a o a b.
-    // Si es mayor, ya no existirán ni a ni b en las distancias.
-    it=Tab_clu.begin();
-    while (it!=Tab_clu.end() and (it->first<a or it->first<b)) {
-        it->second.erase(a);
-        it->second.erase(b);
-        ++it;
-    }
-    // Post: se han eliminado las distancias relacionadas con a y b desde Tab_clu.begin() hasta el 
-    // elemento anterior a it.
+    Nombre[fa]=id_fusion;
+    Nombre[fb]="";
+    Fila.erase(a);
+    Fila.erase(b);
+    Fila.insert(make_pair(id_fusion,fa));
 }
 
 void Cjt_clusters::crea_clusters(const pair<string,double>& e) {
     // Inserta en el p.i. un clúster con su identificación y el árbol c
     BinTree <pair<string,double> > c(e);
     Arbol.insert(make_pair(e.first, c));
+    anade_hoja(e.first);
+}
+
+void Cjt_clusters::crea_tabla_cluster(const Tabla_distancias& t, const vector<string>& nombre) {
+    // Copia en el p.i. la tabla de distancias y el identificador de cada fila
+    Tab_clu=t;
+    Nombre=nombre;
+    Fila.clear();
+    hoja_fila.assign(Tab_clu.num_filas(),-1);
+    // Inv: Fila contiene las filas activas anteriores a i, y hoja_fila y fila_raiz sus hojas
+    for (int i=0; i<Tab_clu.num_filas(); ++i) {
+        if (Tab_clu.fila_activa(i)) {
+            Fila.insert(make_pair(Nombre[i],i));
+            int h=hoja.find(Nombre[i])->second;
+            hoja_fila[i]=h;
+            fila_raiz[raiz(h)]=i;
+        }
+    }
 }
 
-void Cjt_clusters::crea_tabla_cluster(const string& id_a, const map<string,double>& b) {
-    // Inserta en el p.i. la distancia con sus dos identificadores y el double correspondiente
-    Tab_clu.insert(make_pair(id_a,b));
+void Cjt_clusters::usa_pool(Pool_tareas& p) {
+    pool=&p;
+}
+
+void Cjt_clusters::ejecuta_clustering(vector<pair<string,double> >& fusiones) {
+    // Fusiona los clústers a menor distancia hasta que solo queda uno, 
+    // guardando cada fusión en el orden en que se ha hecho
+    fusiones.clear();
+    // Inv: Arbol.size()>=1. fusiones contiene las fusiones hechas hasta ahora
+    while (apto_para_wpgma()) {
+        string a,b;
+        double d;
+        dist_minima(a,b,d);
+        fusiona_cluster (a,b,d);
+        actualiza_tab(a,b);
+        Arbol.erase(a);
+        Arbol.erase(b);
+        fusiones.push_back(make_pair(a+b,d/2));
+    }
+    // Post: el Arbol.size()<=1
+}
+
+void Cjt_clusters::ejecuta_clustering_hasta(double altura) {
+    // Como ejecuta_clustering, pero se para antes de la primera fusión por encima de altura
+    // Inv: Arbol.size()>=1; todas las fusiones hechas tienen altura <= altura
+    while (apto_para_wpgma()) {
+        string a,b;
+        double d;
+        dist_minima(a,b,d);
+        if (d/2>altura) return;
+        fusiona_cluster (a,b,d);
+        actualiza_tab(a,b);
+        Arbol.erase(a);
+        Arbol.erase(b);
+    }
+}
+
+bool Cjt_clusters::graba_traza(const string& fichero) {
+    ofstream f(fichero.c_str(),ios::binary);
+    if (not f) return false;
+    // Los clústers se numeran por orden de fila, sin contar las filas libres
+    int r=Tab_clu.num_filas();
+    vector<int> num(r,-1);
+    vector<int> activas;
+    for (int i=0; i<r; ++i) {
+        if (Tab_clu.fila_activa(i)) {
+            num[i]=activas.size();
+            activas.push_back(i);
+        }
+    }
+    f.write(MARCA_TRAZA,sizeof(MARCA_TRAZA));
+    escribe_binario(f,VERSION_TRAZA);
+    escribe_binario(f,int32_t(activas.size()));
+    for (int i=0; i<activas.size(); ++i) {
+        const string& id=Nombre[activas[i]];
+        escribe_binario(f,int32_t(id.size()));
+        f.write(id.data(),id.size());
+    }
+    for (int i=0; i<activas.size(); ++i) {
+        for (int j=i+1; j<activas.size(); ++j) escribe_binario(f,Tab_clu.consultar(activas[i],activas[j]));
+    }
+    escribe_binario(f,int32_t(activas.size()-1));
+    // Inv: se han grabado las fusiones hechas hasta ahora; activas contiene las filas de los clústers que quedan
+    while (apto_para_wpgma()) {
+        string a,b;
+        double d;
+        dist_minima(a,b,d);
+        int fa=Fila.find(a)->second;
+        int fb=Fila.find(b)->second;
+        fusiona_cluster (a,b,d);
+        actualiza_tab(a,b);
+        Arbol.erase(a);
+        Arbol.erase(b);
+        activas.erase(find(activas.begin(),activas.end(),fb));
+        escribe_binario(f,int32_t(num[fa]));
+        escribe_binario(f,int32_t(num[fb]));
+        escribe_binario(f,d/2);
+        for (int i=0; i<activas.size(); ++i) {
+            if (activas[i]!=fa) escribe_binario(f,Tab_clu.consultar(fa,activas[i]));
+        }
+    }
+    // Post: el p.i. tiene un único clúster
+    f.close();
+    return bool(f);
+}
+
+bool Cjt_clusters::reproduce_traza(const string& fichero, int pasos) {
+    ifstream f(fichero.c_str(),ios::binary);
+    if (not f) return false;
+    f.seekg(0,ios::end);
+    long long tam=f.tellg();
+    f.seekg(0,ios::beg);
+    char marca[sizeof(MARCA_TRAZA)];
+    int32_t version,n;
+    if (not f.read(marca,sizeof(marca)) or memcmp(marca,MARCA_TRAZA,sizeof(marca))!=0) return false;
+    if (not lee_binario(f,version) or version!=VERSION_TRAZA) return false;
+    // Los tamaños se comparan con el del archivo antes de reservar memoria, por si la traza está corrupta
+    if (not lee_binario(f,n) or n<1 or (long long)n*(n-1)/2*sizeof(double)>tam) return false;
+    Cjt_clusters c;
+    vector<string> nombre(n);
+    Tabla_distancias t;
+    for (int i=0; i<n; ++i) {
+        int32_t l;
+        if (not lee_binario(f,l) or l<=0 or l>tam) return false;
+        nombre[i].resize(l);
+        if (not f.read(&nombre[i][0],l) or c.existe_cluster(nombre[i])) return false;
+        c.crea_clusters(make_pair(nombre[i],-1.0));
+        t.anade_fila();
+    }
+    for (int i=0; i<n; ++i) {
+        for (int j=i+1; j<n; ++j) {
+            double d;
+            if (not lee_binario(f,d)) return false;
+            t.modificar(i,j,d);
+        }
+    }
+    c.crea_tabla_cluster(t,nombre);
+    int32_t fusiones;
+    if (not lee_binario(f,fusiones) or fusiones!=n-1) return false;
+    // Inv: c es el estado después de las fusiones anteriores a t
+    for (int t=0; t<min(pasos,int(fusiones)); ++t) {
+        int32_t fa,fb;
+        double h;
+        if (not lee_binario(f,fa) or not lee_binario(f,fb) or not lee_binario(f,h)) return false;
+        if (fa<0 or fa>=n or fb<0 or fb>=n or fa==fb) return false;
+        if (not c.Tab_clu.fila_activa(fa) or not c.Tab_clu.fila_activa(fb)) return false;
+        string a=c.Nombre[fa];
+        string b=c.Nombre[fb];
+        c.fusiona_cluster(a,b,2*h);
+        c.actualiza_tab(a,b);
+        c.Arbol.erase(a);
+        c.Arbol.erase(b);
+        // Las distancias grabadas sustituyen a las medias que ha calculado actualiza_tab
+        for (int i=0; i<n; ++i) {
+            if (i!=fa and c.Tab_clu.fila_activa(i)) {
+                double d;
+                if (not lee_binario(f,d)) return false;
+                c.Tab_clu.modificar(fa,i,d);
+            }
+        }
+    }
+    c.pool=pool;
+    c.fichero_control=fichero_control;
+    c.pasos_control=pasos_control;
+    c.escritura=escritura;
+    *this=c;
+    return true;
+}
+
+bool Cjt_clusters::fija_puntos_control(const string& fichero, int pasos) {
+    espera_control();
+    if (pasos>0) {
+        // Se comprueba que se pueda crear el archivo temporal, sin tocar el último punto grabado
+        string temporal=fichero+".tmp";
+        if (not ofstream(temporal.c_str(),ios::binary)) return false;
+        remove(temporal.c_str());
+    }
+    fichero_control= pasos>0 ? fichero : string();
+    pasos_control=pasos;
+    pasos_desde_control=0;
+    escritura=make_shared<Escritura_control>();
+    escritura->en_curso=false;
+    escritura->correcta=true;
+    return true;
+}
+
+void Cjt_clusters::graba_control() {
+    // Solo hay una escritura en curso a la vez: la copia del estado se hace en este hilo y el resto en el pool
+    espera_control();
+    shared_ptr<Estado_control> e=make_shared<Estado_control>();
+    e->modo=Tab_clu.consultar_modo();
+    e->filas=Tab_clu.num_filas();
+    for (int i=0; i<Tab_clu.num_filas(); ++i) {
+        if (Tab_clu.fila_activa(i)) {
+            e->fila.push_back(i);
+            e->arbol.push_back(Arbol.find(Nombre[i])->second);
+        }
+    }
+    int m=e->fila.size();
+    e->dist.reserve(size_t(m)*(m-1)/2);
+    for (int i=0; i<m; ++i) {
+        for (int j=i+1; j<m; ++j) e->dist.push_back(Tab_clu.consultar(e->fila[i],e->fila[j]));
+    }
+    shared_ptr<Escritura_control> w=escritura;
+    string fichero=fichero_control;
+    {
+        unique_lock<mutex> l(w->m);
+        w->en_curso=true;
+    }
+    function<void()> tarea=[e,w,fichero]() {
+        bool ok=escribe_control(fichero,*e);
+        unique_lock<mutex> l(w->m);
+        w->en_curso=false;
+        if (not ok) w->correcta=false;
+        w->cv.notify_all();
+    };
+    if (pool!=0) pool->envia(tarea);
+    else tarea();
+}
+
+bool Cjt_clusters::reanuda_control(const string& fichero) {
+    ifstream f(fichero.c_str(),ios::binary);
+    if (not f) return false;
+    f.seekg(0,ios::end);
+    long long tam=f.tellg();
+    f.seekg(0,ios::beg);
+    char marca[sizeof(MARCA_CONTROL)];
+    int32_t version,modo,filas,m;
+    if (not f.read(marca,sizeof(marca)) or memcmp(marca,MARCA_CONTROL,sizeof(marca))!=0) return false;
+    if (not lee_binario(f,version) or version!=VERSION_CONTROL) return false;
+    if (not lee_binario(f,modo) or modo<DOBLE or modo>CUANTIZADA) return false;
+    // Los tamaños se comparan con el del archivo antes de reservar memoria, por si el punto está corrupto
+    if (not lee_binario(f,filas) or filas<1 or filas>tam) return false;
+    if (not lee_binario(f,m) or m<1 or m>filas or (long long)m*(m-1)/2*sizeof(double)>tam) return false;
+    Cjt_clusters c;
+    Tabla_distancias t((Modo_tabla(modo)));
+    for (int i=0; i<filas; ++i) t.anade_fila();
+    vector<string> nombre(filas);
+    vector<int32_t> fila(m);
+    vector<char> activa(filas,false);
+    c.hoja_fila.assign(filas,-1);
+    // Inv: c contiene los clústers anteriores a i, con sus especies en el índice de pertenencia
+    for (int i=0; i<m; ++i) {
+        Arbol_clu a;
+        if (not lee_binario(f,fila[i]) or fila[i]<0 or fila[i]>=filas or activa[fila[i]]) return false;
+        if (not lee_arbol(f,tam,a) or c.Arbol.find(a.value().first)!=c.Arbol.end()) return false;
+        activa[fila[i]]=true;
+        nombre[fila[i]]=a.value().first;
+        c.Arbol.insert(make_pair(a.value().first,a));
+        vector<pair<string,double> > h;
+        hojas(a,1,h);
+        int r=-1;
+        for (int x=0; x<h.size(); ++x) {
+            if (c.hoja.find(h[x].first)!=c.hoja.end()) return false;
+            int l=c.anade_hoja(h[x].first);
+            if (r==-1) r=l;
+            else c.padre[l]=r;
+        }
+        c.tam[r]=h.size();
+        c.altura[r]=a.value().second;
+        c.fila_raiz[r]=fila[i];
+        c.hoja_fila[fila[i]]=r;
+        c.Fila.insert(make_pair(a.value().first,fila[i]));
+    }
+    for (int i=0; i<m; ++i) {
+        for (int j=i+1; j<m; ++j) {
+            double d;
+            if (not lee_binario(f,d)) return false;
+            t.modificar(fila[i],fila[j],d);
+        }
+    }
+    for (int i=0; i<filas; ++i) {
+        if (not activa[i]) t.elimina_fila(i);
+    }
+    c.Tab_clu=t;
+    c.Nombre=nombre;
+    c.pool=pool;
+    c.fichero_control=fichero_control;
+    c.pasos_control=pasos_control;
+    c.escritura=escritura;
+    *this=c;
+    return true;
+}
+
+bool Cjt_clusters::inserta_especie(const string& id, const Tabla_distancias& t, const vector<string>& nombre) {
+    map<string,int> fila;
+    for (int i=0; i<nombre.size(); ++i) {
+        if (not nombre[i].empty()) fila.insert(make_pair(nombre[i],i));
+    }
+    Arbol_clu raiz=Arbol.begin()->second;
+    vector<pair<string,double> > h;
+    hojas(raiz,1,h);
+    for (int i=0; i<h.size(); ++i) {
+        if (fila.find(h[i].first)==fila.end()) return false;
+    }
+    int fs=fila.find(id)->second;
+
+    // Clúster X al que se une la especie: camino desde la raíz
+    vector<char> camino, mejor_camino;
+    double mejor=numeric_limits<double>::infinity();
+    busca_union(raiz,numeric_limits<double>::infinity(),fila,t,fs,camino,mejor,mejor_camino);
+    int m=mejor_camino.size();
+    vector<Arbol_clu> nodo(m+1);
+    nodo[0]=raiz;
+    for (int i=0; i<m; ++i) nodo[i+1]= mejor_camino[i]==0 ? nodo[i].left() : nodo[i].right();
+
+    // Sube desde X hasta la raíz. Si C es el hijo del camino de un antecesor, Y su hermano y X está j niveles
+    // por debajo de C, añadir la especie a X cambia la distancia wpgma entre C e Y en (d(s,Y)-d(X,Y))/2^(j+1).
+    // d(X,Y) se toma de la altura guardada del antecesor, d(C,Y) = 2*altura: es exacta cuando X = C (j = 0) y
+    // evita recorrer los pares de hojas de X e Y en los niveles de arriba, cuyo peso es cada vez menor
+    Arbol_clu nuevo=une(nodo[m],Arbol_clu(make_pair(id,-1.0)),mejor);
+    double peso=0.5;
+    // Inv: nuevo es el clúster nodo[i+1] con la especie añadida; peso=1/2^(j+1)
+    for (int i=m-1; i>=0; --i) {
+        Arbol_clu y= mejor_camino[i]==0 ? nodo[i].right() : nodo[i].left();
+        double d_cy=2*nodo[i].value().second;
+        double d_sy=distancia_especie(y,fila,t,fs);
+        double d=d_cy+(d_sy-d_cy)*peso;
+        nuevo=une(nuevo,y,d);
+        peso/=2;
+    }
+    // Post: nuevo es el árbol con la especie añadida
+
+    int f=Fila.begin()->second;
+    // La especie se une al único clúster del índice de pertenencia
+    int r=comprime(hoja_fila[f]);
+    int l=anade_hoja(id);
+    padre[l]=r;
+    ++tam[r];
+    altura[r]=nuevo.value().second;
+    Fila.clear();
+    Fila.insert(make_pair(nuevo.value().first,f));
+    Nombre[f]=nuevo.value().first;
+    Arbol.clear();
+    Arbol.insert(make_pair(nuevo.value().first,nuevo));
+    ++inserciones;
+    return true;
+}
+
+void Cjt_clusters::compara_arbol(const Cjt_clusters& ref, ostream& out) {
+    map<string,double> a, a_ref;
+    alturas(Arbol.begin()->second,a);
+    alturas(ref.Arbol.begin()->second,a_ref);
+    bool igual= a.size()==a_ref.size();
+    double desv=0;
+    // Inv: se han comparado los clústers de a anteriores a it
+    for (map<string,double>::const_iterator it=a.begin(); it!=a.end(); ++it) {
+        map<string,double>::const_iterator r=a_ref.find(it->first);
+        if (r==a_ref.end()) igual=false;
+        else desv=max(desv,fabs(it->second-r->second));
+    }
+    ++comparaciones;
+    if (not igual) ++distintas;
+    out<<"inserciones_incrementales: "<<inserciones<<endl;
+    out<<"topologia: "<<(igual ? "identica" : "distinta")<<endl;
+    out<<"desviacion_maxima_alturas: "<<desv<<endl;
+    out<<"comparaciones_distintas: "<<distintas<<" de "<<comparaciones<<endl;
 }
 
 
 //Escritura
 
-void Cjt_clusters::imprime_tab_distancias () const {
-    // Imprime la tabla de distancias
-    map<string, map <string,double> >::const_iterator it = Tab_clu.begin();
+void Cjt_clusters::imprime_tab_distancias (ostream& out) const {
+    // Imprime la tabla de distancias recorriendo los clústers en orden lexicográfico
+    // (el orden de Fila): cada clúster se imprime con los posteriores a él
+    map<string,int>::const_iterator it = Fila.begin();
     // Inv: Los iteradores posteriors a it no han sido imprimidos
-    // Se han imprimido los valores de it "first" y "second" de los elementos 
-    // entre Tab_clu.begin() y el anterior a it
-    while (it!=Tab_clu.end()) {
-        map <string, double>::const_iterator it_sec = it->second.begin();
-        cout<< (*it).first << ":";
+    // Se han imprimido los clústers entre Fila.begin() y el anterior a it
+    while (it!=Fila.end()) {
+        map<string,int>::const_iterator it_sec = it;
+        ++it_sec;
+        out<< (*it).first << ":";
         // Inv: los iteradores posteriors a it_sec no han sido imprimidos.
-        // Se han imprimido los valores desde it->second.begin al anterior a it_sec
-        while (it_sec!=it->second.end()) { 
-            cout << " "<<(*it_sec).first << " (" << (*it_sec).second <<")";
+        // Se han imprimido las distancias de it con los clústers desde it+1 al anterior a it_sec
+        while (it_sec!=Fila.end()) { 
+            out << " "<<(*it_sec).first << " (" << Tab_clu.consultar(it->second,it_sec->second) <<")";
             ++it_sec;
         }
-        // Post: se han imprimido los elementos desde it->second.begin() hasta it->second.end()-1.
-        cout<<endl;
+        // Post: se han imprimido las distancias de it con los clústers desde it+1 hasta Fila.end()-1.
+        out<<endl;
         ++it;
     }
-    // Post: se han imprimido los elementos de la tabla desde Tab_clu.begin() hasta Tab_clu.end()-1
+    // Post: se han imprimido los elementos de la tabla desde Fila.begin() hasta Fila.end()-1
 }
 
-void Cjt_clusters::imprime_arbol(const BinTree <pair <string,double> >& c) const {
+void Cjt_clusters::imprime_fila(const string& id, ostream& out) const {
+    // Distancias de id con todos los demás clústers, en orden lexicográfico
+    int f=Fila.find(id)->second;
+    out<<id<<":";
+    for (map<string,int>::const_iterator it=Fila.begin(); it!=Fila.end(); ++it) {
+        if (it->second!=f) out<<" "<<it->first<<" ("<<Tab_clu.consultar(f,it->second)<<")";
+    }
+    out<<endl;
+}
+
+void Cjt_clusters::imprime_arbol(const BinTree <pair <string,double> >& c, ostream& out) const {
     // Imprime el árbol c
     if (not c.empty()) {
         if(c.value().second==-1) {
-            cout << '[' << c.value().first << ']';
+            out << '[' << c.value().first << ']';
         }
         else {
-            cout << "[(" << c.value().first << ", " << c.value().second << ") ";
+            out << "[(" << c.value().first << ", " << c.value().second << ") ";
             //BinTree<pair <string,double> >esq = c.left();
-            imprime_arbol(c.left());
+            imprime_arbol(c.left(),out);
             //BinTree<pair <string,double> >dre = c.right();
-            imprime_arbol(c.right());
-            cout << "]";
+            imprime_arbol(c.right(),out);
+            out << "]";
         }
         // HI: Si c es vacío, imprimimos el identificador y hemos acabado. 
         // Sinó, imprimiremos los valores de la raíz (identificador y distancia) 
@@ -214,7 +815,7 @@ void Cjt_clusters::imprime_arbol(const BinTree <pair <string,double> >& c) const
     
 }
 
-void Cjt_clusters::imprime_arbol_filogenetico() {
+void Cjt_clusters::imprime_arbol_filogenetico(ostream& out) {
     // Esta es sin duda la operación más importante del módulo. 
     // Se han añadido varios métodos para completar la funcionalidad de esta, entre
     // los cuales esta el comprobar si aún siguen existiendo más de un clúster los cuales 
@@ -234,9 +835,26 @@ void Cjt_clusters::imprime_arbol_filogenetico() {
         actualiza_tab(a,b);
         Arbol.erase(a);
         Arbol.erase(b);
+        if (pasos_control>0 and ++pasos_desde_control==pasos_control and apto_para_wpgma()) {
+            graba_control();
+            pasos_desde_control=0;
+        }
     }
     // Post: el Arbol.size()=1
+    espera_control();
     map<string, BinTree <pair<string,double> > >::iterator it=Arbol.begin();
-    imprime_arbol(it->second);
+    imprime_arbol(it->second,out);
 
 }
+
+void Cjt_clusters::corta_arbol(double altura, ostream& out) const {
+    vector<Arbol_clu> g;
+    for (map<string,Arbol_clu>::const_iterator it=Arbol.begin(); it!=Arbol.end(); ++it) cortes(it->second,altura,g);
+    sort(g.begin(),g.end(),menor_id);
+    // Inv: se han impreso los grupos anteriores a i
+    for (int i=0; i<g.size(); ++i) {
+        out<<g[i].value().first<<':';
+        imprime_hojas(g[i],out);
+        out<<endl;
+    }
+}
@@ -8,8 +8,13 @@
 #include "BinTree.hh"
 #include <iostream>
 #include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 using namespace std;
 #endif
+#include "Tabla_distancias.hh"
 
 
 /** @class Cjt_clusters
@@ -36,10 +41,116 @@ class Cjt_clusters {
         map< string, BinTree < pair<string,double> > >Arbol; 
 
         /** @brief Conjunto de distancias entre clústers. 
-        El primer elemento del primer bloque es el identificador del clúster, y el primer elemento del segundo
-        bloque es el identificador del segundo clúster. El segundo elemento del segundo bloque es la distancia entre ambas.*/
-        map<string,map<string,double> > Tab_clu;
-            
+        Cada clúster ocupa una fila de la tabla; la distancia entre dos clústers es la de sus filas.*/
+        Tabla_distancias Tab_clu;
+
+        /** @brief Identificador del clúster de cada fila de Tab_clu (vacío si la fila está libre) */
+        vector<string> Nombre;
+
+        /** @brief Fila de Tab_clu de cada clúster; el primer elemento es el identificador del clúster */
+        map<string,int> Fila;
+
+        /** @brief Índice de pertenencia (unión-búsqueda): número de hoja de cada especie de los clústers */
+        unordered_map<string,int> hoja;
+
+        /** @brief Padre de cada hoja en el bosque de unión-búsqueda; las raíces son su propio padre y representan
+        cada una un clúster actual */
+        vector<int> padre;
+
+        /** @brief Para cada raíz del bosque: número de especies, altura (-1 si es una especie) y fila de Tab_clu
+        de su clúster */
+        vector<int> tam;
+        vector<double> altura;
+        vector<int> fila_raiz;
+
+        /** @brief Una hoja del clúster de cada fila activa de Tab_clu */
+        vector<int> hoja_fila;
+
+        /** @brief Pool donde se reparte la búsqueda de la distancia mínima (nulo: en el hilo actual) */
+        Pool_tareas* pool;
+
+        /** @brief Especies añadidas al árbol con inserta_especie desde que se creó el p.i. */
+        int inserciones;
+
+        /** @brief Comparaciones con un árbol reconstruido (compara_arbol) y cuántas han dado una topología distinta */
+        int comparaciones, distintas;
+
+        /** @brief Estado de la escritura de los puntos de control (definida en Cjt_clusters.cc) */
+        struct Escritura_control;
+
+        /** @brief Archivo de los puntos de control (vacío: no se graban), fusiones entre dos puntos y fusiones hechas
+        desde el último */
+        string fichero_control;
+        int pasos_control, pasos_desde_control;
+
+        /** @brief Escritura del último punto de control, que puede estar en curso en el pool */
+        shared_ptr<Escritura_control> escritura;
+
+            /** 
+            @brief Consultora: Busca dónde unir una especie al árbol.
+            \pre fila contiene la fila de t de cada hoja de c; fs es la fila de la especie en t; camino es el camino 
+            desde la raíz hasta c (0: izquierda, 1: derecha); altura_padre es la altura del padre de c.
+            \post Devuelve la distancia wpgma entre la especie y c. Si la distancia es menor que mejor y la especie
+            se uniría a c antes que su hermano (distancia/2 <= altura_padre), mejor pasa a ser esa distancia y
+            mejor_camino, camino.
+            */
+        double busca_union(const BinTree < pair<string,double> >& c, double altura_padre, const map<string,int>& fila,
+                           const Tabla_distancias& t, int fs, vector<char>& camino, double& mejor, 
+                           vector<char>& mejor_camino) const;
+
+            /** 
+            @brief Consultora: Distancia wpgma entre una especie y un clúster.
+            \pre fila contiene la fila de t de cada hoja de c; fs es la fila de la especie en t.
+            \post Devuelve la distancia wpgma (media de las distancias de sus dos hijos) entre la especie y c.
+            */
+        double distancia_especie(const BinTree < pair<string,double> >& c, const map<string,int>& fila,
+                                 const Tabla_distancias& t, int fs) const;
+
+            /** 
+            @brief Consultora: Raíz del clúster de una hoja.
+            \pre 0 <= x < padre.size().
+            \post Devuelve la raíz del bosque de unión-búsqueda que contiene x. Como las uniones son por tamaño, el
+            camino tiene O(log n) hojas.
+            */
+        int raiz(int x) const;
+
+            /** 
+            @brief Modificadora: Raíz del clúster de una hoja, comprimiendo el camino.
+            \pre 0 <= x < padre.size().
+            \post Devuelve raiz(x), y las hojas del camino desde x pasan a tenerla como padre.
+            */
+        int comprime(int x);
+
+            /** 
+            @brief Modificadora: Añade una especie al índice de pertenencia.
+            \pre id no está en el índice.
+            \post id forma un clúster propio en el índice; devuelve su número de hoja.
+            */
+        int anade_hoja(const string& id);
+
+            /** 
+            @brief Modificadora: Une en el índice de pertenencia los clústers de dos filas.
+            \pre Las filas fa y fb son diferentes y están activas.
+            \post Las especies de los clústers de fa y fb forman un único clúster de altura h que ocupa la fila fa.
+            */
+        void une_filas(int fa, int fb, double h);
+
+            /** 
+            @brief Modificadora: Graba un punto de control.
+            \pre fichero_control no está vacío.
+            \post Espera a que acabe la escritura del punto anterior, copia el estado del p.i. (los árboles de los
+            clústers activos y su tabla de distancias) y lanza su escritura al pool (o lo escribe al momento si no
+            hay pool).
+            */
+        void graba_control();
+
+            /** 
+            @brief Consultora: Espera a que acabe la escritura del último punto de control.
+            \pre <em>Cierto.</em>
+            \post No hay ninguna escritura de un punto de control en curso.
+            */
+        void espera_control() const;
+
             /** 
             @brief Consultora: Pasa por referencia los identificadores y la distancia mínima
             \pre <em>Cierto.</em>
@@ -57,9 +168,16 @@ class Cjt_clusters {
             /**
             @brief Acción que imprime el clúster del parámetro.
             \pre El clúster existe en el conjunto.
-            \post Imprime el clúster (su “estructura arborescente”).
+            \post Imprime por el canal out el clúster (su “estructura arborescente”).
+            */
+        void imprime_arbol(const BinTree < pair <string,double> >& c, ostream& out) const;
+
+            /**
+            @brief Acción que imprime la fila de un clúster de la tabla de distancias.
+            \pre El clúster id existe en el p.i.
+            \post Imprime por el canal out el clúster id y sus distancias con todos los demás, en orden lexicográfico.
             */
-        void imprime_arbol(const BinTree < pair <string,double> >& c) const;
+        void imprime_fila(const string& id, ostream& out) const;
 
             /** 
             @brief Modificadora: Actualiza la tabla de distancias con el nuevo clúster.
@@ -108,7 +226,7 @@ class Cjt_clusters {
             \post Encuentra el clúster asociado al identificador pasado por referencia y llama a la función imprime_arbol, 
             pasándole por referencia el clúster encontrado.
             */
-        void imprime_cluster(const string& id_especie) const;
+        void imprime_cluster(const string& id_especie, ostream& out) const;
 
             /** 
             @brief Consultora: Indica si existe el clúster.
@@ -131,8 +249,60 @@ class Cjt_clusters {
             */
         bool apto_para_wpgma() const;
 
-        int calcula_hijos() const;
-        
+            /** 
+            @brief Consultora: Indica si el árbol filogenético está construido.
+            \pre <em>Cierto.</em>
+            \post Indica si el p.i. contiene un único clúster (todos los clústers iniciales se han fusionado).
+            */
+        bool arbol_construido() const;
+
+            /** 
+            @brief Consultora: Clúster actual que contiene una especie.
+            \pre <em>Cierto.</em>
+            \post Indica si alguno de los clústers del p.i. contiene la especie id_especie. En caso afirmativo, id es el
+            identificador de ese clúster, n su número de especies y h su altura (-1 si es la propia especie). Cuesta
+            una búsqueda en una tabla hash y O(log n) pasos en el índice de pertenencia, sin recorrer los clústers.
+            */
+        bool cluster_de(const string& id_especie, string& id, int& n, double& h) const;
+
+            /** 
+            @brief Consultora: Puntos de control programados.
+            \pre <em>Cierto.</em>
+            \post Devuelve el archivo de los puntos de control (vacío si no hay) y cada cuántas fusiones se graban.
+            */
+        const string& consultar_fichero_control() const;
+        int consultar_pasos_control() const;
+
+            /** 
+            @brief Consultora: Indica si los puntos de control se han grabado bien.
+            \pre <em>Cierto.</em>
+            \post Espera a que acabe la escritura en curso y devuelve falso si alguno de los puntos de control del
+            p.i. no se ha podido escribir.
+            */
+        bool control_correcto() const;
+
+            /** 
+            @brief Consultora: Árbol filogenético.
+            \pre arbol_construido().
+            \post Devuelve una referencia constante al árbol del único clúster del p.i. (válida hasta la siguiente
+            modificación del p.i.).
+            */
+        const BinTree < pair<string,double> >& arbol_filogenetico() const;
+
+            /** 
+            @brief Consultora: Memoria de la tabla de distancias.
+            \pre <em>Cierto.</em>
+            \post Devuelve los bytes que ocupan la tabla de distancias del p.i. y los identificadores de sus filas.
+            */
+        size_t bytes_tabla() const;
+
+            /** 
+            @brief Consultora: Memoria de los árboles.
+            \pre <em>Cierto.</em>
+            \post Devuelve una estimación de los bytes que ocupan los nodos de los árboles del p.i.
+            */
+        size_t bytes_arbol() const;
+
 
     //Modificadora
 
@@ -140,43 +310,155 @@ class Cjt_clusters {
             @brief Modificadora: Ejecuta un paso del algoritmo wpgma.
             \pre Existen dos clústers o más.
             \post Algoritmo que localiza los dos clústers a menor distancia, los fusiona y añade la fusión al conjunto del p.i. 
-            Actualiza la tabla de distancias para el p.i. con el nuevo clúster y la imprime por el canal estándar de salida.
+            Actualiza la tabla de distancias para el p.i. con el nuevo clúster y la imprime por el canal out.
             Además, han sido eliminados del p.i. los árboles inicialices antes de fusionarlos.
             */
-        void ejecuta_paso_wpgma();
+        void ejecuta_paso_wpgma(ostream& out);
+
+            /** 
+            @brief Modificadora: Ejecuta un paso del algoritmo wpgma escribiendo solo los cambios.
+            \pre Existen dos clústers o más.
+            \post Igual que ejecuta_paso_wpgma, pero en lugar de la tabla entera imprime por el canal out una línea
+            "fusion: a b (altura)" con los clústers fusionados y la altura del nuevo, y la fila del nuevo clúster
+            "ab: c (d) ..." con sus distancias a todos los demás en orden lexicográfico. Las filas de a y b
+            desaparecen y las demás no cambian, así que el resto de la tabla se deduce de la anterior.
+            */
+        void ejecuta_paso_wpgma_delta(ostream& out);
 
             /** 
             @brief Modificadora: Crea un clúster.
             \pre <em>Cierto.</em>
             \post Crea un clúster con la información pasada por referencia (que contiene el identificador y distancia=-1) y los 
-            añade al conjunto de clústers (p.i). 
+            añade al conjunto de clústers (p.i). La especie se añade al índice de pertenencia como un clúster propio.
             */
         void crea_clusters(const pair<string,double>& e);
 
             /** 
             @brief Modificadora: Crea una tabla de distancias.
+            \pre nombre contiene el identificador de cada fila activa de t, y cada uno de ellos es un clúster del p.i.
+            \post La tabla de distancias del p.i. pasa a ser t, con los clústers identificados por nombre.
+            */
+        void crea_tabla_cluster(const Tabla_distancias& t, const vector<string>& nombre);
+
+            /** 
+            @brief Modificadora: Usa un pool para buscar la distancia mínima.
+            \pre p existe mientras exista el p.i.
+            \post A partir de ahora, la búsqueda de los clústers a menor distancia se reparte entre los hilos de p.
+            */
+        void usa_pool(Pool_tareas& p);
+
+            /** 
+            @brief Modificadora: Ejecuta el algoritmo wpgma hasta obtener un único clúster.
             \pre <em>Cierto.</em>
-            \post Añade la distancia entre el identificador a y el resto de clústers iniciados.
+            \post Fusiona los clústers del p.i. hasta que solo queda uno. fusiones contiene, en orden, el identificador
+            y la distancia de cada clúster creado.
             */
-        void crea_tabla_cluster(const string& a, const map<string,double>& b);
+        void ejecuta_clustering(vector<pair<string,double> >& fusiones);
 
+            /** 
+            @brief Modificadora: Ejecuta el algoritmo wpgma hasta una altura.
+            \pre <em>Cierto.</em>
+            \post Fusiona los clústers del p.i. mientras quede más de uno y el nuevo clúster tenga una altura (la mitad
+            de la distancia mínima) menor o igual que altura. Como las alturas de wpgma no decrecen, los clústers que
+            quedan son los grupos de corta_arbol(altura) del árbol completo, sin construir la parte de encima.
+            */
+        void ejecuta_clustering_hasta(double altura);
+
+            /** 
+            @brief Modificadora: Añade una especie al árbol filogenético sin reconstruirlo.
+            \pre arbol_construido(); id no es un clúster del p.i.; nombre contiene el identificador de cada fila 
+            activa de t, y t contiene las distancias entre las especies de nombre, id incluida.
+            \post Devuelve si todas las hojas del árbol están en nombre. En caso afirmativo, id se ha unido al árbol 
+            como hermana del clúster X a menor distancia wpgma de entre los que se fusionarían con id antes que con
+            su hermano (o de la raíz, si no hay ninguno), en un clúster nuevo de altura d(id,X)/2; las alturas de 
+            los antecesores de X se han recalculado con la fórmula de wpgma, tomando la distancia entre X y el
+            hermano de cada antecesor de la altura guardada del antecesor (exacta para el padre de X). Cuesta O(n)
+            distancias de la tabla, en lugar de repetir todo el algoritmo.
+            */
+        bool inserta_especie(const string& id, const Tabla_distancias& t, const vector<string>& nombre);
+
+            /** 
+            @brief Modificadora: Compara el árbol con uno reconstruido desde cero.
+            \pre El p.i. y ref tienen el árbol construido.
+            \post Imprime por el canal out cuántas especies se han añadido al p.i. con inserta_especie, si la topología 
+            (los clústers) del árbol del p.i. coincide con la de ref, la desviación máxima de las alturas de los 
+            clústers comunes y cuántas de las comparaciones hechas hasta ahora han dado una topología distinta.
+            */
+        void compara_arbol(const Cjt_clusters& ref, ostream& out);
+
+            /** 
+            @brief Modificadora: Ejecuta el algoritmo wpgma hasta el final y graba su traza.
+            \pre El p.i. no está vacío.
+            \post Devuelve si se ha podido crear y escribir completo el archivo fichero. Si se ha podido crear, el
+            p.i. contiene un único clúster y, si devuelve cierto, el archivo contiene la traza binaria de todas las fusiones, desde la tabla actual del p.i.
+            (enteros de 32 bits y reales de 64, en el orden de bytes de la máquina):
+            la marca "WPGM" y la versión 1; el número n de clústers; el identificador de cada uno en orden de fila
+            (longitud y caracteres); las n(n-1)/2 distancias de la tabla, para i < j en orden (i, j); el número de
+            fusiones, y para cada fusión los números de los clústers fusionados a y b, la altura del nuevo y sus
+            distancias a los demás clústers que quedan, de menor a mayor número. El nuevo clúster toma el número de
+            a, y el de b deja de existir. Si no se ha podido crear el archivo, el p.i. no cambia.
+            */
+        bool graba_traza(const string& fichero);
+
+            /** 
+            @brief Modificadora: Reconstruye un estado intermedio a partir de una traza.
+            \pre pasos >= 0.
+            \post Devuelve si fichero contiene una traza válida (ver graba_traza). En caso afirmativo, los clústers
+            y la tabla de distancias del p.i. pasan a ser los de la traza después de sus min(pasos, fusiones)
+            primeras fusiones; el algoritmo puede continuar desde ahí. Si no, el p.i. no cambia.
+            */
+        bool reproduce_traza(const string& fichero, int pasos);
+
+            /** 
+            @brief Modificadora: Programa los puntos de control de imprime_arbol_filogenetico.
+            \pre pasos >= 0.
+            \post Devuelve si se puede escribir en fichero. En caso afirmativo (o si pasos = 0), a partir de ahora
+            imprime_arbol_filogenetico graba un punto de control en fichero cada pasos fusiones (pasos = 0: nunca).
+            Cada punto se escribe en segundo plano en un archivo temporal que después sustituye a fichero, así que
+            fichero siempre contiene el último punto completo. El formato es binario (enteros de 32 bits y reales de
+            64, en el orden de bytes de la máquina): la marca "WPGC" y la versión 1; el modo de la tabla y su número
+            de filas; el número m de clústers activos; para cada uno, en orden de fila, su fila y su árbol en
+            preorden (identificador con su longitud y altura, y los dos hijos si la altura no es -1), y las
+            m(m-1)/2 distancias entre los clústers activos, para i < j en orden (i, j).
+            */
+        bool fija_puntos_control(const string& fichero, int pasos);
+
+            /** 
+            @brief Modificadora: Recupera el estado de un punto de control.
+            \pre <em>Cierto.</em>
+            \post Devuelve si fichero contiene un punto de control válido (ver fija_puntos_control). En caso
+            afirmativo, los clústers y la tabla de distancias del p.i. pasan a ser los del punto, y acabar el algoritmo
+            desde ahí da el mismo árbol que sin interrupción. Si no, el p.i. no cambia. Los puntos de control
+            programados se conservan.
+            */
+        bool reanuda_control(const string& fichero);
  
     //Lectura y escritura
     
             /**
             @brief Acción que imprime la tabla de distancias entre clústers
             \pre <em>Cierto.</em>
-            \post Imprime la tabla de distancias del p.i. entre clústers por el canal estándar de salida.
+            \post Imprime la tabla de distancias del p.i. entre clústers por el canal out.
+            */
+        void imprime_tab_distancias(ostream& out) const;
+
+            /**
+            @brief Acción que imprime los grupos que resultan de cortar los clústers a una altura.
+            \pre <em>Cierto.</em>
+            \post Imprime por el canal out, en orden lexicográfico de identificador, una línea "id: a b ..." por cada
+            grupo: los subárboles máximos de los clústers del p.i. con altura menor o igual que altura (o las especies
+            que no están en ninguno), con sus especies en el orden del árbol. Cuesta O(n) más la ordenación de los
+            grupos.
             */
-        void imprime_tab_distancias() const;
+        void corta_arbol(double altura, ostream& out) const;
 
             /**
             @brief Acción que imprime el clúster. 
             \pre <em>Cierto.</em>
-            \post El algoritmo ha fusionado los clústers hasta unirlos en un único árbol. 
-            Imprime por el canal estándar de salida el árbol generado.
+            \post El algoritmo ha fusionado los clústers hasta unirlos en un único árbol, grabando los puntos de
+            control programados (fija_puntos_control). Imprime por el canal out el árbol generado.
             */
-        void imprime_arbol_filogenetico();
+        void imprime_arbol_filogenetico(ostream& out);
 
 };
 
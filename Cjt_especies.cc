@@ -3,207 +3,939 @@
 */
 
 #include "Cjt_especies.hh"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+static void en_paralelo(Pool_tareas* pool, int n, const function<void(int)>& f) {
+    // Ejecuta f(i) para cada i de [0...n-1] en los hilos del pool; sin pool, cada hilo
+    // se encarga de un bloque de valores consecutivos
+    if (pool!=0) {
+        pool->paralelo(n,f);
+        return;
+    }
+    int h=thread::hardware_concurrency();
+    if (h<1) h=1;
+    if (h>n) h=n;
+    vector<thread> hilos;
+    // Inv: se han lanzado los hilos anteriores a t
+    for (int t=0; t<h; ++t) {
+        hilos.push_back(thread([&f,n,h,t]() {
+            for (int i=(long long)n*t/h; i<(long long)n*(t+1)/h; ++i) f(i);
+        }));
+    }
+    for (int t=0; t<h; ++t) hilos[t].join();
+}
+
+static void calcula_distancias(Pool_tareas* pool, const vector<pair<const Especie*,const Especie*> >& pares,
+                               vector<double>& d) {
+    // Calcula en paralelo la distancia de cada par
+    d.resize(pares.size());
+    en_paralelo(pool,pares.size(),[&pares,&d](int i) { d[i]=pares[i].first->distancia(*pares[i].second); });
+}
+
+/*
+* Memoria de trabajo de un hilo del bootstrap, que se reutiliza entre sus réplicas.
+*/
+struct Arena_bootstrap {
+    Perfiles_compactos p;
+    Tabla_distancias t;
+    Soporte_clados::Recorrido r;
+    vector<int> veces;
+    int replicas;
+};
+
+/*
+* Cola acotada de la lectura en cadena, sin cerrojos, que comparten el hilo que lee e inserta las especies y los
+* trabajadores del pool que calculan sus perfiles. La especie i ocupa la ranura i % VENTANA_LECTURA: la lectura la
+* publica pasando leidas a i+1, un trabajador la toma pasando tomadas a i+1 y, cuando ha calculado sus perfiles,
+* guarda i en perfilada de la ranura para que la lectura la inserte. Como mucho hay max_activos trabajadores.
+*/
+struct Cola_lectura {
+    struct Ranura {
+        string id,gen;
+        Especie e;
+        atomic<int> perfilada;
+        Ranura() : perfilada(-1) {}
+    };
+    vector<Ranura> ranura;
+    atomic<int> leidas,tomadas,activos;
+    int max_activos;
+    int k;
+    Alfabeto alfabeto;
+    vector<int> ks;
+    explicit Cola_lectura(int v) : ranura(v), leidas(0), tomadas(0), activos(0) {}
+};
+
+static bool activa_trabajador(Cola_lectura& c) {
+    // Suma un trabajador activo si hay menos de max_activos
+    int a=c.activos;
+    while (a<c.max_activos) {
+        if (c.activos.compare_exchange_weak(a,a+1)) return true;
+    }
+    return false;
+}
+
+static bool perfila_siguiente(Cola_lectura& c) {
+    // Toma la siguiente especie publicada y calcula sus perfiles; devuelve falso si no hay ninguna
+    int i=c.tomadas;
+    do {
+        if (i>=c.leidas) return false;
+    } while (not c.tomadas.compare_exchange_weak(i,i+1));
+    Cola_lectura::Ranura& r=c.ranura[i%c.ranura.size()];
+    r.e=Especie(move(r.id),move(r.gen),c.k,c.alfabeto);
+    if (not c.ks.empty()) r.e.calcula_perfiles(c.ks);
+    r.perfilada=i;
+    return true;
+}
+
+static void trabaja_lectura(shared_ptr<Cola_lectura> c) {
+    // Antes de acabar, el trabajador vuelve a mirar la cola: si la lectura ha publicado una especie cuando había
+    // max_activos trabajadores, no ha enviado ninguno nuevo
+    do {
+        while (perfila_siguiente(*c));
+        --c->activos;
+    } while (c->tomadas<c->leidas and activa_trabajador(*c));
+}
 
 //Constructora y destructora
 
-Cjt_especies::Cjt_especies(){}
+const int Cjt_especies::FILAS_TAREA;
+const int Cjt_especies::VENTANA_LECTURA;
 
-Cjt_especies::~Cjt_especies(){}  
+Cjt_especies::Cjt_especies(){
+    motor=BLOQUES;
+    alfabeto=AUTOMATICO;
+    bytes_compactos=0;
+    presupuesto=0;
+    estimacion=0;
+    pool=0;
+    pendientes=0;
+}
+
+Cjt_especies::~Cjt_especies(){
+    espera_tabla();
+}  
+
+void Cjt_especies::usa_pool(Pool_tareas& p) {
+    espera_tabla();
+    pool=&p;
+}
 
 
 //Consultoras
 
 bool Cjt_especies::existe_especie(const string& id_especie) const {
     // Indica si la especie existe en el conjunto
-    map<string,Especie>::const_iterator it = Cjt.find(id_especie);
-    if (it != Cjt.end()) return true;
-    return false;
+    return Cjt.buscar(id_especie)>=0;
 }
 
-string Cjt_especies::obtener_gen(const string& id_especie) const {
+const string& Cjt_especies::obtener_gen(const string& id_especie) const {
     // Proporciona el gen del identificador 
-    map<string,Especie>::const_iterator it=Cjt.find(id_especie);
-    return (*it).second.consultar_gen();
+    return Cjt.consultar(Cjt.buscar(id_especie)).consultar_gen();
 }
 
 double Cjt_especies::distancia_cjt(const string& id_a, const string& id_b) const{
     // Devuelve la distancia entre dos identificadores
-    map<string,Especie>::const_iterator it_a=Cjt.find(id_a);
-    map<string,Especie>::const_iterator it_b=Cjt.find(id_b);
     //Llama a la función distancia con las especies encontradas 
     //de los identificadores id_a y id_b
-    return it_a->second.distancia(it_b->second);
+    return Cjt.consultar(Cjt.buscar(id_a)).distancia(Cjt.consultar(Cjt.buscar(id_b)));
+}
+
+size_t Cjt_especies::memoria_estimada() const {
+    return estimacion;
+}
+
+size_t Cjt_especies::consultar_presupuesto() const {
+    return presupuesto;
+}
+
+Alfabeto Cjt_especies::consultar_alfabeto() const {
+    return alfabeto;
+}
+
+size_t Cjt_especies::bytes() const {
+    size_t especies,perfiles;
+    Cjt.bytes(especies,perfiles);
+    unique_lock<mutex> l(m_indice);
+    return especies+perfiles+Tabla.bytes()+Indice.bytes()+bytes_compactos;
+}
+
+shared_ptr<Perfiles_compactos> Cjt_especies::cuenta_compactos(Perfiles_compactos&& p) const {
+    // Los bytes se descuentan cuando se destruye la última copia del puntero (al acabar las tareas que lo usan)
+    size_t b=p.bytes();
+    bytes_compactos+=b;
+    return shared_ptr<Perfiles_compactos>(new Perfiles_compactos(move(p)),[this,b](Perfiles_compactos* q) {
+        bytes_compactos-=b;
+        delete q;
+    });
+}
+
+size_t Cjt_especies::limite_densa(const Perfiles_compactos& p) const {
+    // Sin presupuesto solo limita MAX_DENSA; con presupuesto, la matriz tiene que caber con todo lo demás
+    if (presupuesto==0) return numeric_limits<size_t>::max();
+    size_t usado=bytes()+p.bytes();
+    return presupuesto>usado ? presupuesto-usado : 0;
+}
+
+bool Cjt_especies::caben_copias(int copias) const {
+    estimacion=bytes()+copias*Tabla.bytes();
+    return presupuesto==0 or estimacion<=presupuesto;
+}
+
+size_t Cjt_especies::estima_especie(const string& id, const string& gen, int k) const {
+    // La memoria de cada perfil se acota como si todos sus substrings fueran diferentes
+    size_t b=sizeof(Especie)+id.capacity()+gen.capacity()+Especie::estima_bytes_perfil(gen.size(),k);
+    for (int j=0; j<ks.size(); ++j) b+=Especie::estima_bytes_perfil(gen.size(),ks[j]);
+    return b;
+}
+
+bool Cjt_especies::cabe_tabla(int filas, size_t otros) const {
+    // Con la representación más compacta, o en un archivo con el resto del presupuesto
+    return presupuesto==0 or Tabla.en_archivo() or otros+Tabla_distancias::bytes_tabla(filas,CUANTIZADA)<=presupuesto
+        or (not dir_presupuesto.empty() and otros<presupuesto);
+}
+
+bool Cjt_especies::perfil_disponible(int k) const {
+    // Todas las especies tienen los mismos perfiles: basta con mirar una
+    const vector<int>& orden=Cjt.orden();
+    return orden.empty() or Cjt.consultar(orden[0]).tiene_perfil(k);
+}
+
+double Cjt_especies::distancia_cjt(const string& id_a, const string& id_b, int k) const {
+    return Cjt.consultar(Cjt.buscar(id_a)).distancia(Cjt.consultar(Cjt.buscar(id_b)),k);
+}
+
+void Cjt_especies::crea_distancias_k(Tabla_distancias& t, int k) const {
+    // t tiene las filas del registro; la fila j guarda las distancias con las filas anteriores, así que 
+    // los hilos se reparten las filas de forma intercalada para equilibrar el trabajo
+    t=Tabla_distancias(Tabla.consultar_modo());
+    int n=Cjt.num_filas();
+    for (int f=0; f<n; ++f) t.anade_fila();
+    for (int f=n-1; f>=0; --f) {
+        if (not Cjt.fila_ocupada(f)) t.elimina_fila(f);
+    }
+    if (motor!=FUSION) {
+        Perfiles_compactos q;
+        compacta(q,k);
+        if (motor==INDICE) q.indexa();
+        else if (motor==DENSA) q.densifica(limite_densa(q));
+        shared_ptr<Perfiles_compactos> c=cuenta_compactos(move(q));
+        const Perfiles_compactos& p=*c;
+        const vector<int>& orden=Cjt.orden();
+        int m=orden.size();
+        Motor_tabla mt=motor;
+        en_paralelo(pool,(m+FILAS_TAREA-1)/FILAS_TAREA,[&p,&t,&orden,m,mt](int b) {
+            int i=b*FILAS_TAREA;
+            function<void(int,int,double)> escribe=[&t,&orden](int a, int c, double d) {
+                t.modificar(orden[a],orden[c],d);
+            };
+            if (mt==INDICE) p.distancias_indice(i,min(m,i+FILAS_TAREA),escribe);
+            else if (mt==DENSA) p.distancias_densa(i,min(m,i+FILAS_TAREA),escribe);
+            else p.distancias(i,min(m,i+FILAS_TAREA),i+1,m,escribe);
+        });
+        return;
+    }
+    int h= pool!=0 ? pool->num_hilos()+1 : thread::hardware_concurrency();
+    if (h<1) h=1;
+    en_paralelo(pool,h,[this,&t,k,n,h](int p) {
+        // Inv: se han calculado las filas n-1-p, n-1-p-h, ... posteriores a j
+        for (int j=n-1-p; j>0; j-=h) {
+            if (Cjt.fila_ocupada(j)) {
+                const Especie& e=Cjt.consultar(j);
+                for (int i=0; i<j; ++i) {
+                    if (Cjt.fila_ocupada(i)) t.modificar(i,j,e.distancia(Cjt.consultar(i),k));
+                }
+            }
+        }
+    });
+}
+
+void Cjt_especies::compacta(Perfiles_compactos& p, int k) const {
+    const vector<int>& orden=Cjt.orden();
+    vector<const Perfil*> perfiles(orden.size());
+    for (int i=0; i<orden.size(); ++i) {
+        const Especie& e=Cjt.consultar(orden[i]);
+        perfiles[i]= k==0 ? &e.consultar_kmer() : &e.perfil(k);
+    }
+    p.construye(perfiles);
+}
+
+vector<string> Cjt_especies::nombres() const {
+    // Identificador de la especie de cada fila de la tabla
+    vector<string> nombre(Tabla.num_filas());
+    for (int f=0; f<nombre.size(); ++f) {
+        if (Cjt.fila_ocupada(f)) nombre[f]=Cjt.consultar(f).consultar_id_especie();
+    }
+    return nombre;
 }
 
 
 //Modificadoras
 
-void Cjt_especies::crea_especie(const Especie& e) {
-    // Inserta la especie e al conjunto de especies
-    Cjt.insert(make_pair(e.consultar_id_especie(),e));
-    inserta_tab(e);
+void Cjt_especies::lanza(function<void()> tarea, const vector<int>& filas) {
+    // Las filas dejan de estar listas hasta que acaba su tarea
+    if (pool==0) {
+        tarea();
+        for (int i=0; i<filas.size(); ++i) lista[filas[i]]=true;
+    }
+    else {
+        {
+            unique_lock<mutex> l(m_tabla);
+            for (int i=0; i<filas.size(); ++i) lista[filas[i]]=false;
+            ++pendientes;
+        }
+        pool->envia([this,tarea,filas]() {
+            tarea();
+            unique_lock<mutex> l(m_tabla);
+            for (int i=0; i<filas.size(); ++i) lista[filas[i]]=true;
+            --pendientes;
+            cv_tabla.notify_all();
+        });
+    }
+}
+
+void Cjt_especies::espera_fila(int f) const {
+    unique_lock<mutex> l(m_tabla);
+    cv_tabla.wait(l,[this,f]() { return lista[f]; });
+}
+
+void Cjt_especies::espera_tabla() const {
+    unique_lock<mutex> l(m_tabla);
+    cv_tabla.wait(l,[this]() { return pendientes==0; });
+}
+
+void Cjt_especies::crea_especie(Especie&& e) {
+    // Mueve la especie e al conjunto de especies, en la fila que le asigna la tabla.
+    // Antes hay que esperar a la tabla: añadir una fila puede reubicar la tabla y el registro
+    espera_tabla();
+    if (e.consultar_alfabeto()!=alfabeto) e.cambia_alfabeto(alfabeto);
+    if (not ks.empty()) e.calcula_perfiles(ks);
+    nuevas.clear();
+    int f=Tabla.anade_fila();
+    Cjt.inserta(f,move(e));
+    Indice.inserta(Cjt,f);
+    inserta_tab(f);
 }
 
 void Cjt_especies::elimina_especie(const string& id_especie) {
     // Elimina la especie e del conjunto de especies
-    elimina_tab(id_especie);
-    Cjt.erase(id_especie);
+    espera_tabla();
+    int f=Cjt.buscar(id_especie);
+    elimina_tab(f);
+    Indice.elimina(Cjt,f);
+    Cjt.elimina(f);
 }
 
 void Cjt_especies::crea_distancias () {
-    // Crea la tabla de distancias para el conjunto de especies
-    map<string,Especie>::iterator it_a=Cjt.begin();
-
-    // Inv: it<=Cjt.end()
-    // Se han calculado y añadido a la tabla de distancias las distancias de los elementos anteriores a it_a
-    // con el resto de especies. Las distancias de los elementos posteriores a it_a no han sido tratadas.
-    while (it_a!=Cjt.end()) {
-        map<string,Especie>::iterator it_b=it_a;
-        ++it_b;
-        map<string,double> aux;
-        // Inv: it_a<it_b<=Cjt.end()
-        // Se han calculado y añadido las distancias de los elementos anteriores a it_b
-        // con it_a. Las distancias de it_a con los elementos posteriores a it_b no han sido tratadas.
-        while (it_b!=Cjt.end()){
-            double d=it_a->second.distancia(it_b->second);
-            aux.insert(make_pair((*it_b).first,d));
-            ++it_b;
-        }
-        // Post: se han calculado todas las distancias de los elementos desde it_b=it_a+1
-        // hasta Cjt.end()-1
-        Tabla.insert(make_pair((*it_a).first,aux));
-        ++it_a;
-    }
-    // Post: se han calculado todas las distancias de los elementos desde Cjt.begin()
-    // hasta Cjt.end()-1
-}
-
-void Cjt_especies::inserta_tab(const Especie& e) {
-    // Inserta las distancias en la tabla del conjunto con la nueva especie e
-    map<string, map<string,double> >::iterator it = Tabla.begin();
-    string id=e.consultar_id_especie();
-    map<string,double> aux;
-    // Inv: it<=Tabla.end()
-    // Se han recalculado las distancias de los elementos anteriores a it.
-    // Las distancias de los elementos posteriores a it no han sido calculadas.
-    while (it!=Tabla.end()) {
-        if (id>(*it).first) {
-            double d=e.distancia(Cjt.find(it->first)->second);
-            it->second.insert(make_pair(id,d));
-        }
-        else if (id<(*it).first) {
-            double d=e.distancia(Cjt.find(it->first)->second);
-            aux.insert(make_pair((*it).first,d));
+    // Crea la tabla de distancias para el conjunto de especies.
+    // Cada especie ocupa en la tabla la misma fila que en el registro
+    espera_tabla();
+    Tabla.vacia();
+    int n=Cjt.num_filas();
+    for (int f=0; f<n; ++f) Tabla.anade_fila();
+    for (int f=n-1; f>=0; --f) {
+        if (not Cjt.fila_ocupada(f)) Tabla.elimina_fila(f);
+    }
+    lista.assign(n,true);
+    nuevas.clear();
+
+    // La tarea de cada especie calcula sus distancias con las posteriores en orden lexicográfico,
+    // que son las que se imprimen en su fila
+    shared_ptr<vector<int> > orden=make_shared<vector<int> >(Cjt.orden());
+    if (motor!=FUSION) {
+        // Cada tarea se encarga de FILAS_TAREA especies consecutivas
+        Perfiles_compactos q;
+        compacta(q,0);
+        if (motor==INDICE) q.indexa();
+        else if (motor==DENSA) q.densifica(limite_densa(q));
+        shared_ptr<Perfiles_compactos> p=cuenta_compactos(move(q));
+        int m=orden->size();
+        Motor_tabla mt=motor;
+        // Inv: se han lanzado las tareas de las especies de orden[0...i-1]
+        for (int i=0; i<m; i+=FILAS_TAREA) {
+            int fin=min(m,i+FILAS_TAREA);
+            lanza([this,orden,p,i,fin,m,mt]() {
+                function<void(int,int,double)> escribe=[this,&orden](int a, int b, double d) {
+                    Tabla.modificar((*orden)[a],(*orden)[b],d);
+                };
+                if (mt==INDICE) p->distancias_indice(i,fin,escribe);
+                else if (mt==DENSA) p->distancias_densa(i,fin,escribe);
+                else p->distancias(i,fin,i+1,m,escribe);
+            },vector<int>(orden->begin()+i,orden->begin()+fin));
         }
-        ++it;
+        return;
+    }
+    // Inv: se han lanzado las tareas de las especies de orden[0...i-1]
+    for (int i=0; i<orden->size(); ++i) {
+        lanza([this,orden,i]() {
+            const Especie& e=Cjt.consultar((*orden)[i]);
+            // Inv: se han calculado las distancias de orden[i] con las especies de orden[i+1...j-1]
+            for (int j=i+1; j<orden->size(); ++j) {
+                Tabla.modificar((*orden)[i],(*orden)[j],e.distancia(Cjt.consultar((*orden)[j])));
+            }
+        },vector<int>(1,(*orden)[i]));
     }
-    // Post: se han recalculado todas las distancias de los elementos desde Tabla.begin()
-    // hasta Tabla.end()-1
-    Tabla.insert(make_pair(id,aux));
+    // Post: se han lanzado las tareas de todas las especies del conjunto
+}
+
+void Cjt_especies::inserta_tab(int f) {
+    // Inserta las distancias en la tabla del conjunto con la nueva especie de la fila f
+    if (f>=lista.size()) lista.resize(f+1,true);
+    nuevas.push_back(f);
+    // La tarea reparte la fila entre los hilos del pool
+    lanza([this,f]() {
+        const Especie& e=Cjt.consultar(f);
+        en_paralelo(pool,Cjt.num_filas(),[this,&e,f](int i) {
+            if (i!=f and Cjt.fila_ocupada(i)) Tabla.modificar(f,i,e.distancia(Cjt.consultar(i)));
+        });
+    },vector<int>(1,f));
+}
+
+void Cjt_especies::elimina_tab(int f) {
+    // Libera la fila f de la tabla
+    Tabla.elimina_fila(f);
 }
 
-void Cjt_especies::elimina_tab(const string& id) {
-    // Elimina las distancias de la tabla del conjunto con la especie del identificador
-    map<string, map<string,double> >::iterator it = Tabla.begin();
-    // Inv: it<=Tabla.end()
-    // Se han eliminado las distancias de los elementos anteriores a it.
-    // Las distancias de los elementos posteriores a it no han sido tratadas.
-    while (it!=Tabla.end() and (it->first)<id) {
-        it->second.erase(id);
-        ++it;
+void Cjt_especies::crea_clusters(Cjt_clusters& clu, const Tabla_distancias& t) const {
+    const vector<int>& orden=Cjt.orden();
+    // Inv: Se han creado los clústers de las especies anteriores a i.
+    for (int i=0; i<orden.size(); ++i) {
+        pair <string,double> aux;
+        aux.first=Cjt.consultar(orden[i]).consultar_id_especie();
+        aux.second=-1;
+        clu.crea_clusters(aux);
     }
-    // Post: se han eliminado todas las distancias de los elementos desde Tabla.begin()
-    // hasta el anterior a it
-    Tabla.erase(it);
+    // Post: se han creado los clústers de todas las especies del conjunto.
+    clu.crea_tabla_cluster(t,nombres());
+    if (pool!=0) clu.usa_pool(*pool);
 }
 
-void Cjt_especies::inicializa_clusters (Cjt_clusters& clu) {
+bool Cjt_especies::inicializa_clusters (Cjt_clusters& clu) {
     // Función que comunica información del conjunto de especies con el conjunto de clústers
     // consiguiendo así incializar un clúster para cada especie y crear la tabla inicial
-    // del conjunto de clústers    
-    if (not Cjt.empty()) {
-        map<string,map<string,double>>::const_iterator it=Tabla.begin();
-        map<string,double>::const_iterator it_sec=it->second.begin();
-
-        // Inv: it<=Tabla.end()
-        // Se han creado los clústers de los elementos anteriores a it.
-        // Las distancias de los elementos posteriores a it no han sido tratados.
-        while (it!=Tabla.end()) {
-            pair <string,double> aux;
-            aux.first=it->first;
-            aux.second=-1;
-            clu.crea_clusters(aux);
-            map<string,double> b;
-            it_sec=it->second.begin();
-            // Inv: it_sec<=it->second.end()
-            // b ha recogido la información de los identificadores y distancias desde
-            // it->second.begin() hasta el elemento anterior a it_sec con el it actual
-            while (it_sec!=it->second.end()) {
-                b.insert(make_pair(it_sec->first,it_sec->second));
-                ++it_sec;
-            }
-            // Post: b ha recogido la información de los identificadores y distancias desde
-            // it->second.begin() hasta it->second.end()-1 con el it actual
-            clu.crea_tabla_cluster(it->first,b);
-            ++it;
+    // del conjunto de clústers, que empieza siendo una copia de la tabla de especies
+    espera_tabla();
+    if (not caben_copias(1)) return false;
+    crea_clusters(clu,Tabla);
+    return true;
+}
+
+bool Cjt_especies::inicializa_clusters(Cjt_clusters& clu, int k) const {
+    // Igual, pero con una tabla calculada con el perfil de k
+    if (not caben_copias(2)) return false;
+    Tabla_distancias t;
+    crea_distancias_k(t,k);
+    crea_clusters(clu,t);
+    return true;
+}
+
+bool Cjt_especies::inserta_en_clusters(Cjt_clusters& clu, const string& id_especie) {
+    // La inserción consulta distancias entre cualquier par de especies del árbol
+    espera_tabla();
+    return clu.inserta_especie(id_especie,Tabla,nombres());
+}
+
+void Cjt_especies::perfiles_k(const vector<int>& nuevos_ks) {
+    // Añade los nuevos k a ks y calcula en paralelo los perfiles que faltan a cada especie
+    espera_tabla();
+    ks.insert(ks.end(),nuevos_ks.begin(),nuevos_ks.end());
+    sort(ks.begin(),ks.end());
+    ks.erase(unique(ks.begin(),ks.end()),ks.end());
+    const vector<int>& orden=Cjt.orden();
+    en_paralelo(pool,orden.size(),[this,&orden](int i) { Cjt.modificar(orden[i]).calcula_perfiles(ks); });
+}
+
+void Cjt_especies::cambia_alfabeto(Alfabeto a) {
+    // Recalcula en paralelo los perfiles de todas las especies; el índice y la tabla dependen de ellos
+    espera_tabla();
+    if (a==alfabeto) return;
+    alfabeto=a;
+    const vector<int>& orden=Cjt.orden();
+    en_paralelo(pool,orden.size(),[this,&orden](int i) { Cjt.modificar(orden[i]).cambia_alfabeto(alfabeto); });
+    Indice.invalida();
+    crea_distancias();
+}
+
+void Cjt_especies::cambia_modo_tabla(Modo_tabla m) {
+    // Recalcula la tabla con la nueva representación
+    espera_tabla();
+    Tabla.cambia_modo(m);
+    crea_distancias();
+}
+
+bool Cjt_especies::tabla_en_disco(const string& dir, int mb) {
+    // Recalcula la tabla en un archivo del directorio dir
+    espera_tabla();
+    bool ok=Tabla.usa_archivo(dir,mb);
+    crea_distancias();
+    return ok;
+}
+
+void Cjt_especies::tabla_en_memoria() {
+    // Recalcula la tabla en memoria
+    espera_tabla();
+    Tabla.usa_memoria();
+    crea_distancias();
+}
+
+void Cjt_especies::cambia_motor_tabla(Motor_tabla m) {
+    // Recalcula la tabla con el nuevo motor
+    espera_tabla();
+    motor=m;
+    crea_distancias();
+}
+
+void Cjt_especies::fija_presupuesto(size_t mb, const string& dir) {
+    presupuesto=mb<<20;
+    dir_presupuesto=dir;
+}
+
+bool Cjt_especies::ajusta_tabla(int filas, size_t otros) {
+    // Si la tabla no cabe, se prueban las representaciones más compactas (de más a menos precisa) y después el disco
+    Modo_tabla m=Tabla.consultar_modo();
+    estimacion=otros+Tabla_distancias::bytes_tabla(filas,m);
+    if (presupuesto==0 or Tabla.en_archivo() or estimacion<=presupuesto) return true;
+    const Modo_tabla compactos[2]={SIMPLE,CUANTIZADA};
+    for (int i=0; i<2; ++i) {
+        size_t b=Tabla_distancias::bytes_tabla(filas,compactos[i]);
+        if (b<Tabla_distancias::bytes_tabla(filas,m) and otros+b<=presupuesto) {
+            Tabla.cambia_modo(compactos[i]);
+            return true;
         }
-        // Post: se han creado los clústers desde los elementos "first" de Tabla.begin()
-        // a Tabla.end()-1. Se han creado también todas las distancias de entre elementos sin 
-        // repetición de información
     }
+    if (not dir_presupuesto.empty() and otros<presupuesto and
+        Tabla.usa_archivo(dir_presupuesto,max(size_t(1),(presupuesto-otros)>>20))) return true;
+    estimacion=otros+Tabla_distancias::bytes_tabla(filas,CUANTIZADA);
+    return false;
 }
 
 
 //Lectura y escritura
 
-void Cjt_especies::lee_cjt_especies(const int k) {
-    // Lee un conjunto de especies
-    Cjt.clear();
-    Tabla.clear();
+bool Cjt_especies::lee_cjt_especies(istream& in, const int k) {
+    // Lee un conjunto de especies; la especie i ocupa la fila i
+    espera_tabla();
+    Cjt.vacia();
+    Indice.invalida();
     int n;
-    cin>>n;
-    // Inv: 0<=i<=n. Se han leído y añadido al conjunto las especies anteriores a i.
-    // Las especies entre [i...n-1] aún no han sido tratadas.
-    for (int i=0; i<n; ++i) {
-        Especie e;
-        e.lee_especie(k);
-        Cjt.insert(make_pair(e.consultar_id_especie(), e));
+    in>>n;
+    if (pool!=0) {
+        size_t otros=lee_en_cadena(in,n,k);
+        if (presupuesto==0) return true;
+        // Con presupuesto, la representación de la tabla depende de la memoria de todas las especies,
+        // así que la tabla se calcula al acabar la lectura
+        if (not ajusta_tabla(n,otros)) {
+            Cjt.vacia();
+            crea_distancias();
+            return false;
+        }
+        crea_distancias();
+        return true;
+    }
+    // Se leen primero los identificadores y los genes; los substrings de cada especie se calculan en paralelo
+    vector<string> id(n),gen(n);
+    for (int i=0; i<n; ++i) in>>id[i]>>gen[i];
+    // Antes de calcular los perfiles y la tabla se comprueba que quepan en el presupuesto
+    size_t otros=0;
+    for (int i=0; i<n; ++i) otros+=estima_especie(id[i],gen[i],k);
+    if (not ajusta_tabla(n,otros)) {
+        crea_distancias();
+        return false;
     }
+    Cjt.reserva(n);
+    vector<Especie> e(n);
+    en_paralelo(pool,n,[this,&id,&gen,&e,k](int i) {
+        e[i]=Especie(move(id[i]),move(gen[i]),k,alfabeto);
+        if (not ks.empty()) e[i].calcula_perfiles(ks);
+    });
+    // Inv: 0<=i<=n. Se han añadido al conjunto las especies anteriores a i.
+    for (int i=0; i<n; ++i) Cjt.inserta(i,move(e[i]));
     // Post: han sido leídas y añadidas al conjunto las especies desde [i=0...i=n-1].
     crea_distancias();
+    return true;
+}
+
+size_t Cjt_especies::lee_en_cadena(istream& in, int n, int k) {
+    // Este hilo lee las especies y las publica en la cola, de donde las toman los trabajadores del pool para
+    // calcular sus perfiles; las inserta en orden en cuanto están perfiladas. Como mucho hay VENTANA_LECTURA
+    // especies leídas y sin insertar
+    Cjt.reserva(n);
+    // Sin presupuesto, cada FILAS_TAREA especies insertadas se lanza la tarea de sus distancias con las anteriores
+    bool filas= presupuesto==0;
+    if (filas) {
+        Tabla.vacia();
+        for (int f=0; f<n; ++f) Tabla.anade_fila();
+        lista.assign(n,true);
+        // La tabla se imprime cuando han acabado las tareas de todas las filas
+        nuevas.resize(n);
+        for (int f=0; f<n; ++f) nuevas[f]=f;
+    }
+    int v=VENTANA_LECTURA;
+    shared_ptr<Cola_lectura> c=make_shared<Cola_lectura>(v);
+    c->max_activos=pool->num_hilos();
+    c->k=k;
+    c->alfabeto=alfabeto;
+    c->ks=ks;
+    // Con los motores de perfiles compactos, cada bloque de especies se compacta con códigos compartidos por
+    // todos los bloques (y con su índice invertido o su matriz densa); con FUSION, las tareas usan las especies
+    int b=FILAS_TAREA;
+    shared_ptr<vector<shared_ptr<Perfiles_compactos> > > bloques=
+        make_shared<vector<shared_ptr<Perfiles_compactos> > >((n+b-1)/b);
+    shared_ptr<vector<const Especie*> > especie=make_shared<vector<const Especie*> >(n);
+    Perfiles_compactos::Diccionario codigo;
+    // Las matrices densas de todos los bloques juntas no ocupan más que la de un solo conjunto
+    size_t densa_libre=Perfiles_compactos::max_bytes_densa();
+    Motor_tabla mt=motor;
+    int insertadas=0;
+    function<bool(bool)> inserta=[&](bool espera) {
+        // Inserta la siguiente especie si está perfilada (o cuando lo esté, si espera) y devuelve si lo ha hecho.
+        // Mientras espera, este hilo también calcula perfiles
+        Cola_lectura::Ranura& r=c->ranura[insertadas%v];
+        while (r.perfilada!=insertadas) {
+            if (not espera) return false;
+            if (not perfila_siguiente(*c)) this_thread::yield();
+        }
+        int i=insertadas++;
+        Cjt.inserta(i,move(r.e));
+        (*especie)[i]=&Cjt.consultar(i);
+        if (not filas or ((i+1)%b!=0 and i!=n-1)) return true;
+        int t=i/b;
+        vector<int> fb;
+        for (int f=t*b; f<=i; ++f) fb.push_back(f);
+        if (mt!=FUSION) {
+            vector<const Perfil*> perfiles;
+            for (int f=t*b; f<=i; ++f) perfiles.push_back(&(*especie)[f]->consultar_kmer());
+            Perfiles_compactos q;
+            q.construye(perfiles,codigo);
+            if (mt==INDICE) q.indexa();
+            else if (mt==DENSA and q.densifica(densa_libre)) densa_libre-=q.bytes_densa();
+            (*bloques)[t]=cuenta_compactos(move(q));
+        }
+        lanza([this,bloques,especie,b,t,i,mt]() {
+            if (mt==FUSION) {
+                // Inv: se han calculado las distancias de las filas del bloque anteriores a f con las anteriores
+                for (int f=t*b; f<=i; ++f) {
+                    for (int g=0; g<f; ++g) Tabla.modificar(f,g,(*especie)[f]->distancia(*(*especie)[g]));
+                }
+                return;
+            }
+            const Perfiles_compactos& p=*(*bloques)[t];
+            // Inv: se han calculado las distancias del bloque con los bloques anteriores a a
+            for (int a=0; a<t; ++a) {
+                function<void(int,int,double)> escribe=[this,b,t,a](int x, int y, double d) {
+                    Tabla.modificar(t*b+x,a*b+y,d);
+                };
+                if (mt==INDICE) p.distancias_indice(*(*bloques)[a],escribe);
+                else if (mt==DENSA) p.distancias_densa(*(*bloques)[a],escribe);
+                else p.distancias(*(*bloques)[a],escribe);
+            }
+            function<void(int,int,double)> escribe=[this,b,t](int x, int y, double d) {
+                Tabla.modificar(t*b+x,t*b+y,d);
+            };
+            int m=p.num_perfiles();
+            if (mt==INDICE) p.distancias_indice(0,m,escribe);
+            else if (mt==DENSA) p.distancias_densa(0,m,escribe);
+            else p.distancias(0,m,0,m,escribe);
+        },fb);
+        return true;
+    };
+    // Con presupuesto, en cuanto las especies leídas ya no caben se dejan de calcular perfiles: el resto
+    // solo se lee para estimar la memoria
+    size_t otros=0;
+    bool cabe=true;
+    // Inv: se han leído las especies anteriores a i y se han insertado las anteriores a insertadas
+    for (int i=0; i<n; ++i) {
+        string id,gen;
+        in>>id>>gen;
+        otros+=estima_especie(id,gen,k);
+        cabe= cabe and (presupuesto==0 or cabe_tabla(n,otros));
+        if (cabe) {
+            // Con la cola llena, se espera a la especie más antigua antes de publicar la siguiente
+            if (i-insertadas==v) inserta(true);
+            Cola_lectura::Ranura& r=c->ranura[i%v];
+            r.id=move(id);
+            r.gen=move(gen);
+            c->leidas=i+1;
+            if (activa_trabajador(*c)) pool->envia([c]() { trabaja_lectura(c); });
+            while (insertadas<=i and inserta(false));
+        }
+    }
+    while (insertadas<c->leidas) inserta(true);
+    return otros;
 }
 
-void Cjt_especies::imprime_cjt_especies() const{
-    // Imprime un conjunto de especies
-    map<string,Especie>::const_iterator it = Cjt.begin();
-    // Inv: Los iteradores posteriors a it no han sido imprimidos
-    // Se han imprimido los valores de it "second" (especies) de los elementos entre Cjt.begin()
-    // y el anterior a it
-	while(it != Cjt.end()) {
-		(*it).second.imprime_especie();
-        ++it;
+void Cjt_especies::imprime_cjt_especies(ostream& out) const{
+    // Imprime un conjunto de especies en orden lexicográfico
+    const vector<int>& orden=Cjt.orden();
+    // Inv: Se han imprimido las especies de orden[0...i-1]
+	for (int i=0; i<orden.size(); ++i) {
+		Cjt.consultar(orden[i]).imprime_especie(out);
 	}
-    // Post: se han imprimido los elementos del conjunto desde Cjt.begin() hasta Cjt.end()-1
-}
-
-void Cjt_especies::tabla_distancias() const{
-    // Imprime la tabla de distancias del conjunto de especies
-    map<string, map <string,double> >::const_iterator it = Tabla.begin();
-    // Inv: Los iteradores posteriors a it no han sido imprimidos
-    // Se han imprimido los valores de it de los elementos entre Tabla.begin() y el anterior a it
-    while (it!=Tabla.end()) {
-        map <string, double>::const_iterator it_sec = it->second.begin();
-        cout<< (*it).first << ":";
-        // Inv: los iteradores posteriors a it_sec no han sido imprimidos.
-        // Se han imprimido los valores desde it->second.begin al anterior a it_sec
-        while (it_sec!=it->second.end()) { 
-            cout << " "<<(*it_sec).first << " (" << (*it_sec).second <<")";
-            ++it_sec;
+    // Post: se han imprimido todas las especies del conjunto
+}
+
+void Cjt_especies::tabla_distancias(ostream& out) const{
+    // Imprime la tabla de distancias del conjunto de especies. Cada fila se imprime en cuanto
+    // su tarea (y las de las especies creadas después de crear la tabla) ha acabado
+    for (int i=0; i<nuevas.size(); ++i) espera_fila(nuevas[i]);
+    const vector<int>& orden=Cjt.orden();
+    // Inv: Se han imprimido las especies de orden[0...i-1]
+    for (int i=0; i<orden.size(); ++i) {
+        espera_fila(orden[i]);
+        out<< Cjt.consultar(orden[i]).consultar_id_especie() << ":";
+        // Inv: Se han imprimido las distancias de orden[i] con las especies de orden[i+1...j-1]
+        for (int j=i+1; j<orden.size(); ++j) { 
+            out << " "<<Cjt.consultar(orden[j]).consultar_id_especie() << " (" << Tabla.consultar(orden[i],orden[j]) <<")";
+        }
+        // Post: se han imprimido las distancias de orden[i] con las especies posteriores.
+        out<<endl;
+    }
+    // Post: se han imprimido los elementos de la tabla de todas las especies
+}
+
+void Cjt_especies::tabla_distancias(ostream& out, int k) const {
+    // Calcula la tabla con el perfil de k y la imprime como tabla_distancias
+    Tabla_distancias t;
+    crea_distancias_k(t,k);
+    const vector<int>& orden=Cjt.orden();
+    // Inv: Se han imprimido las especies de orden[0...i-1]
+    for (int i=0; i<orden.size(); ++i) {
+        out<< Cjt.consultar(orden[i]).consultar_id_especie() << ":";
+        for (int j=i+1; j<orden.size(); ++j) { 
+            out << " "<<Cjt.consultar(orden[j]).consultar_id_especie() << " (" << t.consultar(orden[i],orden[j]) <<")";
+        }
+        out<<endl;
+    }
+    // Post: se han imprimido los elementos de la tabla de todas las especies
+}
+
+void Cjt_especies::distancias_lote(const vector<pair<string,string> >& pares, ostream& out) const {
+    // Cada identificador diferente se busca una sola vez
+    unordered_map<string,int> busca;
+    vector<pair<int,int> > f(pares.size());
+    // Inv: se han buscado las especies de los pares anteriores a i
+    for (int i=0; i<pares.size(); ++i) {
+        unordered_map<string,int>::const_iterator b=busca.find(pares[i].first);
+        if (b==busca.end()) b=busca.insert(make_pair(pares[i].first,Cjt.buscar(pares[i].first))).first;
+        f[i].first=b->second;
+        b=busca.find(pares[i].second);
+        if (b==busca.end()) b=busca.insert(make_pair(pares[i].second,Cjt.buscar(pares[i].second))).first;
+        f[i].second=b->second;
+    }
+    // Post: f contiene las filas (o -1) de las especies de todos los pares
+
+    // Las distancias se leen de la tabla si esta es exacta (modo DOBLE); si no, se calculan en paralelo
+    if (Tabla.consultar_modo()==DOBLE) espera_tabla();
+    vector<double> d(pares.size(),0);
+    vector<int> pendiente;
+    vector<pair<const Especie*,const Especie*> > calc;
+    for (int i=0; i<pares.size(); ++i) {
+        if (f[i].first>=0 and f[i].second>=0 and f[i].first!=f[i].second) {
+            if (Tabla.consultar_modo()==DOBLE) d[i]=Tabla.consultar(f[i].first,f[i].second);
+            else {
+                pendiente.push_back(i);
+                calc.push_back(make_pair(&Cjt.consultar(f[i].first),&Cjt.consultar(f[i].second)));
+            }
+        }
+    }
+    vector<double> res;
+    calcula_distancias(pool,calc,res);
+    for (int i=0; i<pendiente.size(); ++i) d[pendiente[i]]=res[i];
+
+    ostringstream buf;
+    // Inv: se han escrito en buf los resultados de los pares anteriores a i
+    for (int i=0; i<pares.size(); ++i) {
+        bool existe_a=f[i].first>=0;
+        bool existe_b=f[i].second>=0;
+        if (existe_a and existe_b) buf<<d[i]<<endl;
+        else if (not existe_a and not existe_b) {
+            buf<<"ERROR: La especie "<<pares[i].first<<" y la especie "<<pares[i].second<<" no existen."<<endl;
         }
-        // Post: se han imprimido los elementos desde it->second.begin() hasta it->second.end()-1.
-        cout<<endl;
-        ++it;
+        else if (not existe_a) buf<<"ERROR: La especie "<<pares[i].first<<" no existe."<<endl;
+        else buf<<"ERROR: La especie "<<pares[i].second<<" no existe."<<endl;
+    }
+    out<<buf.str();
+}
+
+void Cjt_especies::existe_lote(const vector<string>& ids, ostream& out) const {
+    ostringstream buf;
+    // Inv: se han escrito en buf los resultados de los identificadores anteriores a i
+    for (int i=0; i<ids.size(); ++i) {
+        if (Cjt.buscar(ids[i])>=0) buf<<"SI"<<endl;
+        else buf<<"NO"<<endl;
+    }
+    out<<buf.str();
+}
+
+void Cjt_especies::vecinos(const string& id_especie, double umbral, ostream& out) const {
+    // Cada hilo comprueba un bloque de filas y deja la distancia de las que no superan el umbral
+    int f=Cjt.buscar(id_especie);
+    const Especie& e=Cjt.consultar(f);
+    int n=Cjt.num_filas();
+    vector<double> d(n);
+    vector<char> cerca(n,false);
+    en_paralelo(pool,n,[this,&e,f,umbral,&d,&cerca](int i) {
+        if (i!=f and Cjt.fila_ocupada(i)) cerca[i]=e.distancia_hasta(Cjt.consultar(i),umbral,d[i]);
+    });
+    vector<pair<double,string> > res;
+    for (int i=0; i<n; ++i) {
+        if (cerca[i]) res.push_back(make_pair(d[i],Cjt.consultar(i).consultar_id_especie()));
+    }
+    sort(res.begin(),res.end());
+    ostringstream buf;
+    for (int i=0; i<res.size(); ++i) buf<<res[i].second<<" ("<<res[i].first<<")"<<endl;
+    out<<buf.str();
+}
+
+void Cjt_especies::k_vecinos(const string& id_especie, int k, ostream& out) const {
+    {
+        unique_lock<mutex> l(m_indice);
+        if (not Indice.es_valido()) Indice.construye(Cjt);
     }
-    // Post: se han imprimido los elementos de la tabla desde Tabla.begin() hasta Tabla.end()-1
+    vector<pair<double,string> > res;
+    Indice.k_vecinos(Cjt,Cjt.buscar(id_especie),k,res);
+    ostringstream buf;
+    for (int i=0; i<res.size(); ++i) buf<<res[i].second<<" ("<<res[i].first<<")"<<endl;
+    out<<buf.str();
 }
 
+void Cjt_especies::precision_tabla(ostream& out) const {
+    // Compara la tabla del p.i. y el árbol que genera con los obtenidos en modo DOBLE
+    // La tabla de referencia tiene las mismas filas que Tabla
+    espera_tabla();
+    Tabla_distancias ref(DOBLE);
+    int n=Tabla.num_filas();
+    for (int i=0; i<n; ++i) ref.anade_fila();
+    for (int i=n-1; i>=0; --i) {
+        if (not Tabla.fila_activa(i)) ref.elimina_fila(i);
+    }
+    double desv_tabla=0;
+    // Inv: se han comparado las distancias entre las filas anteriores a j
+    for (int j=1; j<n; ++j) {
+        if (Tabla.fila_activa(j)) {
+            for (int i=0; i<j; ++i) {
+                if (Tabla.fila_activa(i)) {
+                    double d=Cjt.consultar(i).distancia(Cjt.consultar(j));
+                    ref.modificar(i,j,d);
+                    double desv=fabs(d-Tabla.consultar(i,j));
+                    if (desv>desv_tabla) desv_tabla=desv;
+                }
+            }
+        }
+    }
+    // Post: ref es la tabla en modo DOBLE y desv_tabla la desviación máxima de Tabla
+
+    Cjt_clusters c_ref, c;
+    crea_clusters(c_ref,ref);
+    crea_clusters(c,Tabla);
+    vector<pair<string,double> > f_ref, f;
+    c_ref.ejecuta_clustering(f_ref);
+    c.ejecuta_clustering(f);
+
+    double desv_alturas=0;
+    int distinto=-1;
+    // Inv: se han comparado las fusiones anteriores a i
+    for (int i=0; i<f.size() and distinto==-1; ++i) {
+        if (f[i].first!=f_ref[i].first) distinto=i;
+        else {
+            double desv=fabs(f[i].second-f_ref[i].second);
+            if (desv>desv_alturas) desv_alturas=desv;
+        }
+    }
+    // Post: desv_alturas es la desviación máxima de las alturas de las fusiones iguales
+    out<<"desviacion_maxima_tabla: "<<desv_tabla<<endl;
+    out<<"desviacion_maxima_alturas: "<<desv_alturas<<endl;
+    if (distinto==-1) out<<"orden_fusiones: identico"<<endl;
+    else out<<"orden_fusiones: distinto desde la fusion "<<distinto+1<<endl;
+}
+
+void Cjt_especies::memoria(ostream& out, const Cjt_clusters& clu) const {
+    size_t especies,perfiles;
+    Cjt.bytes(especies,perfiles);
+    size_t indice;
+    {
+        unique_lock<mutex> l(m_indice);
+        indice=Indice.bytes();
+    }
+    size_t tabla=Tabla.bytes();
+    size_t compactos=bytes_compactos;
+    size_t tabla_clu=clu.bytes_tabla();
+    size_t arbol=clu.bytes_arbol();
+    out<<"especies: "<<especies<<endl;
+    out<<"perfiles: "<<perfiles<<endl;
+    out<<"perfiles_compactos: "<<compactos<<endl;
+    out<<"tabla: "<<tabla<<endl;
+    out<<"indice_vecinos: "<<indice<<endl;
+    out<<"tabla_clusters: "<<tabla_clu<<endl;
+    out<<"arbol_clusters: "<<arbol<<endl;
+    out<<"total: "<<especies+perfiles+compactos+tabla+indice+tabla_clu+arbol<<endl;
+    Modo_tabla m=Tabla.consultar_modo();
+    out<<"representacion_tabla: "<<(m==DOBLE ? "doble" : m==SIMPLE ? "simple" : "cuantizada");
+    if (Tabla.en_archivo()) out<<" en disco";
+    out<<endl;
+    out<<"presupuesto: ";
+    if (presupuesto==0) out<<"sin limite"<<endl;
+    else out<<presupuesto<<endl;
+}
+
+bool Cjt_especies::bootstrap(const Cjt_clusters& clu, int replicas, unsigned semilla, ostream& out) const {
+    espera_tabla();
+    Soporte_clados s(clu.arbol_filogenetico(),semilla);
+    const vector<string>& h=s.hojas();
+    int n=h.size();
+    vector<const Perfil*> perfiles(n);
+    // Inv: se han encontrado las especies de las hojas anteriores a i
+    for (int i=0; i<n; ++i) {
+        int f=Cjt.buscar(h[i]);
+        if (f<0) return false;
+        perfiles[i]=&Cjt.consultar(f).consultar_kmer();
+    }
+    Perfiles_compactos base;
+    base.construye(perfiles);
+
+    // Cada hilo necesita su tabla y la copia de los clústers; se lanzan tantos como caben en el presupuesto
+    Modo_tabla m=Tabla.consultar_modo();
+    int hilos= pool!=0 ? pool->num_hilos()+1 : max(1,int(thread::hardware_concurrency()));
+    if (presupuesto!=0) {
+        size_t usado=bytes();
+        size_t por_hilo=2*Tabla_distancias::bytes_tabla(n,m);
+        size_t caben= presupuesto>usado ? (presupuesto-usado)/por_hilo : 0;
+        if (caben<size_t(hilos)) hilos=max(size_t(1),caben);
+    }
+    hilos=max(1,min(hilos,replicas));
+
+    vector<Arena_bootstrap> arena(hilos);
+    atomic<int> siguiente(0);
+    en_paralelo(pool,hilos,[&](int w) {
+        Arena_bootstrap& a=arena[w];
+        a.t.cambia_modo(m);
+        for (int i=0; i<n; ++i) a.t.anade_fila();
+        a.veces.assign(s.num_clados(),0);
+        a.replicas=0;
+        int r;
+        // Inv: a contiene los clados de las réplicas que ha hecho este hilo
+        while ((r=siguiente++)<replicas) {
+            // La semilla de cada réplica depende solo de su número
+            seed_seq sq={semilla,unsigned(r)};
+            mt19937_64 gen(sq);
+            a.p.remuestrea(base,gen);
+            a.p.distancias(0,n,0,n,[&a](int i, int j, double d) { a.t.modificar(i,j,d); });
+            Cjt_clusters c;
+            for (int i=0; i<n; ++i) c.crea_clusters(make_pair(h[i],-1.0));
+            c.crea_tabla_cluster(a.t,h);
+            vector<pair<string,double> > f;
+            c.ejecuta_clustering(f);
+            s.cuenta(c.arbol_filogenetico(),a.r,a.veces);
+            ++a.replicas;
+        }
+    });
+    for (int w=0; w<hilos; ++w) s.suma(arena[w].veces,arena[w].replicas);
+    s.imprime(out);
+    return true;
+}
@@ -6,7 +6,29 @@
 #define CJT_ESPECIES_HH
 
 #include "Especie.hh"
+#include "Registro_especies.hh"
 #include "Cjt_clusters.hh"
+#include "Pool_tareas.hh"
+#include "Indice_vecinos.hh"
+#include "Perfiles_compactos.hh"
+#include "Soporte_clados.hh"
+#ifndef NO_DIAGRAM
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#endif
+
+/** @brief Forma de calcular la tabla de distancias de un conjunto de especies.
+
+    FUSION calcula cada distancia con Especie::distancia (fusión de los perfiles, implementación de referencia).
+    BLOQUES calcula las distancias con una copia compacta de los perfiles (ver Perfiles_compactos), recorriendo los
+    pares por bloques. INDICE acumula los productos escalares con un índice invertido de los substrings sobre los
+    mismos perfiles compactos, sin coste para los pares que no comparten ningún substring. DENSA guarda los perfiles
+    como una matriz densa de repeticiones y calcula todos los productos escalares como una multiplicación de
+    matrices por bloques; si hay demasiados substrings diferentes para la matriz, se comporta como BLOQUES. Todos
+    los motores dan exactamente las mismas distancias.
+*/
+enum Motor_tabla { FUSION, BLOQUES, INDICE, DENSA };
 
 
 /** @class Cjt_especies
@@ -26,13 +48,126 @@ class Cjt_especies {
 
     private: 
 
-    /** @brief Conjunto de especies; el primer elemento es el identificador y el segundo es la especie */
-    map<string,Especie> Cjt; 
+    /** @brief Conjunto de especies, indexado por identificador. Cada especie ocupa la misma fila que en Tabla */
+    Registro_especies Cjt; 
 
     /** @brief Conjunto de distancias entre especies. 
-    El primer elemento del primer bloque es el identificador de una especie, y el primer elemento del segundo
-    bloque es el identificador de la segunda especie. El segundo elemento del segundo bloque es la distancia entre ambas.*/
-    map <string, map<string,double> > Tabla; // Las dos claves son los dos id_especies diferentes y su distancia.
+    Cada especie ocupa una fila de la tabla; la distancia entre dos especies es la de sus filas.*/
+    Tabla_distancias Tabla;
+
+    /** @brief Valores de k (ordenados) cuyo perfil tienen todas las especies, además del k con el que se han creado */
+    vector<int> ks;
+
+    /** @brief Índice de vecinos más cercanos de las especies. Se actualiza al crear y eliminar especies, y se 
+    reconstruye en la siguiente consulta cuando deja de ser válido */
+    mutable Indice_vecinos Indice;
+
+    /** @brief Protege la reconstrucción del índice, que pueden pedir varias consultas a la vez */
+    mutable mutex m_indice;
+
+    /** @brief Motor con el que se calculan las tablas de distancias completas */
+    Motor_tabla motor;
+    /** @brief Alfabeto con el que se calculan los perfiles de todas las especies */
+    Alfabeto alfabeto;
+
+    /** @brief Memoria máxima, en bytes, para las especies, sus perfiles y las tablas de distancias (0: sin límite) */
+    size_t presupuesto;
+
+    /** @brief Directorio donde se guarda la tabla si no cabe en el presupuesto (vacío: no se guarda en disco) */
+    string dir_presupuesto;
+
+    /** @brief Memoria estimada en la última comprobación del presupuesto */
+    mutable size_t estimacion;
+
+    /** @brief Bytes de los perfiles compactos (con su índice invertido o matriz densa) que están usando las
+    tareas de la tabla */
+    mutable atomic<size_t> bytes_compactos;
+
+    /** @brief Filas (en orden lexicográfico) de cada tarea de los motores con perfiles compactos */
+    static const int FILAS_TAREA=32;
+
+    /** @brief Especies que pueden estar a la vez entre las etapas de la lectura en cadena */
+    static const int VENTANA_LECTURA=256;
+
+    /** @brief Pool donde se calculan las distancias en segundo plano (nulo: se calculan al momento) */
+    Pool_tareas* pool;
+
+    /** @brief Indica para cada fila de Tabla si la tarea que calcula sus distancias ha acabado. 
+    Al crear la tabla, la tarea de una especie calcula sus distancias con las especies posteriores en orden
+    lexicográfico; al crear una especie, la tarea calcula sus distancias con todas las demás. */
+    vector<char> lista;
+
+    /** @brief Filas de las especies creadas cuyas tareas pueden estar en curso */
+    vector<int> nuevas;
+
+    /** @brief Número de tareas de la tabla en curso */
+    int pendientes;
+
+    /** @brief Protege lista y pendientes */
+    mutable mutex m_tabla;
+
+    /** @brief Avisa de que ha acabado una tarea de la tabla */
+    mutable condition_variable cv_tabla;
+
+            /** 
+            @brief Modificadora: Calcula distancias de la tabla.
+            \pre <em>Cierto.</em>
+            \post Ejecuta tarea en el pool (o al momento si no hay pool). Cuando acaba, las filas de filas pasan a 
+            estar listas.
+            */
+        void lanza(function<void()> tarea, const vector<int>& filas);
+
+            /**
+            @brief Lectura: Lee un conjunto de especies en cadena.
+            \pre El p.i. está vacío, tiene pool y no tiene tareas en curso; hay preparadas en el canal in n especies.
+            \post Este hilo lee las especies y las publica en una cola acotada sin cerrojos de VENTANA_LECTURA
+            ranuras, de donde las toman (como mucho tantos como hilos del pool) los trabajadores que calculan sus
+            perfiles; las inserta en orden en cuanto están perfiladas. Con la cola llena, la lectura espera a la
+            especie más antigua (calculando perfiles mientras tanto) en lugar de acumular especies. Sin presupuesto,
+            cada FILAS_TAREA especies insertadas se lanza la tarea de sus distancias con las especies anteriores con el
+            motor del p.i. (sobre los perfiles compactos del bloque, con su índice invertido o su matriz densa, o con
+            Especie::distancia), de modo que la tabla se calcula mientras se leen las especies siguientes. Con
+            presupuesto, la tabla queda por calcular y, en cuanto las especies leídas dejan de caber (cabe_tabla), las
+            siguientes solo se leen. Devuelve la memoria estimada de las n especies (estima_especie).
+            */
+        size_t lee_en_cadena(istream& in, int n, int k);
+
+            /** 
+            @brief Consultora: Perfiles compactos de las especies.
+            \pre Todas las especies del p.i. tienen el perfil de k (k = 0: el k con el que se han creado).
+            \post p contiene los perfiles de k de las especies del p.i. en orden lexicográfico.
+            */
+        void compacta(Perfiles_compactos& p, int k) const;
+
+            /** 
+            @brief Consultora: Cuenta unos perfiles compactos en la memoria del p.i.
+            \pre <em>Cierto.</em>
+            \post Devuelve un puntero con los perfiles de p. Mientras exista alguna copia del puntero, sus bytes se
+            cuentan en bytes_compactos (y, por tanto, en memoria y en el presupuesto).
+            */
+        shared_ptr<Perfiles_compactos> cuenta_compactos(Perfiles_compactos&& p) const;
+
+            /** 
+            @brief Consultora: Memoria disponible para la matriz densa de unos perfiles compactos.
+            \pre <em>Cierto.</em>
+            \post Devuelve los bytes que puede ocupar la matriz densa de p sin pasar del presupuesto, contando la
+            memoria que ya usa el p.i. y la de p (sin límite si no hay presupuesto).
+            */
+        size_t limite_densa(const Perfiles_compactos& p) const;
+
+            /** 
+            @brief Consultora: Espera a que la tarea de una fila acabe.
+            \pre La fila f existe en la tabla.
+            \post La tarea de la fila f ha acabado.
+            */
+        void espera_fila(int f) const;
+
+            /** 
+            @brief Consultora: Espera a que se acabe de calcular toda la tabla.
+            \pre <em>Cierto.</em>
+            \post No hay ninguna tarea de la tabla en curso.
+            */
+        void espera_tabla() const;
 
             /** 
             @brief Modificadora: Crea una tabla de distancias para el conjunto.
@@ -43,17 +178,81 @@ class Cjt_especies {
 
             /** 
             @brief Modificadora: Modifica la tabla de distancias después de añadir una especie.
-            \pre Las distancias de la nueva especie añadida al conjunto no existen en la tabla del p.i.
-            \post Se añaden las distancias con todo el conjunto de la especie nueva pasada por referencia en la tabla de distancias.
+            \pre La nueva especie añadida al conjunto ocupa la fila f y sus distancias no existen en la tabla del p.i.
+            \post Se añaden las distancias con todo el conjunto de la especie de la fila f en la tabla de distancias.
+            */
+        void inserta_tab(int f);
+
+            /** 
+            @brief Modificadora: Modifica la tabla de distancias antes de eliminar una especie.
+            \pre La especie que se va a eliminar ocupa la fila f.
+            \post La fila f de la tabla de distancias ha quedado libre.
+            */
+        void elimina_tab(int f);
+
+            /** 
+            @brief Consultora: Calcula una tabla de distancias con un k concreto.
+            \pre Todas las especies del p.i. tienen el perfil de k.
+            \post t tiene las mismas filas y la misma representación que la tabla del p.i., y contiene las distancias 
+            entre las especies calculadas con sus substrings de k carácteres. Las filas se calculan en paralelo.
+            */
+        void crea_distancias_k(Tabla_distancias& t, int k) const;
+
+            /** 
+            @brief Consultora: Inicializa un conjunto de clústers con las especies del p.i. y una tabla.
+            \pre t tiene las mismas filas que la tabla del p.i.
+            \post Se ha creado en clu un clúster individual para cada especie del p.i., con t como tabla de distancias.
+            */
+        void crea_clusters(Cjt_clusters& clu, const Tabla_distancias& t) const;
+
+            /** 
+            @brief Consultora: Devuelve el identificador de la especie de cada fila.
+            \pre <em>Cierto.</em>
+            \post Devuelve, para cada fila de la tabla, el identificador de su especie (vacío si la fila está libre).
+            */
+        vector<string> nombres() const;
+
+            /** 
+            @brief Consultora: Memoria que ocupa el p.i.
+            \pre <em>Cierto.</em>
+            \post Devuelve los bytes que ocupan las especies, sus perfiles, la tabla de distancias y el índice de vecinos.
             */
-        void inserta_tab(const Especie& e);
+        size_t bytes() const;
 
             /** 
-            @brief Modificadora: Modifica la tabla de distancias después de eliminar una especie.:
-            \pre La especie con el id pasado por referencia existía en el conjunto pero ha sido eliminada.
-            \post Se han eliminado las distancias de la tabla asociadas a la especie pasada por referencia que ha sido previamente eliminada.
+            @brief Modificadora: Ajusta la tabla de distancias al presupuesto de memoria.
+            \pre No hay ninguna tarea de la tabla en curso.
+            \post estimacion es otros más la memoria de una tabla de filas filas con la representación actual, y se
+            devuelve si cabe en el presupuesto. Si no cabe, la tabla del p.i. (que queda vacía) pasa a la primera
+            representación más compacta con la que cabe o, si no cabe con ninguna, a un archivo en dir_presupuesto
+            con el resto del presupuesto residente; en estos casos también se devuelve cierto. Si no cabe de ninguna
+            forma, estimacion es la memoria con la representación más compacta.
             */
-        void elimina_tab(const string& id);
+        bool ajusta_tabla(int filas, size_t otros);
+
+            /** 
+            @brief Consultora: Memoria estimada de una especie.
+            \pre <em>Cierto.</em>
+            \post Devuelve la memoria de la especie de identificador id y gen gen, con la de sus perfiles de k y de
+            cada k de ks acotada como si todos sus substrings fueran diferentes.
+            */
+        size_t estima_especie(const string& id, const string& gen, int k) const;
+
+            /** 
+            @brief Consultora: Indica si una tabla puede caber en el presupuesto de memoria.
+            \pre <em>Cierto.</em>
+            \post Indica si ajusta_tabla(filas, otros) puede encontrar una representación de la tabla que quepa en el
+            presupuesto (sin tener en cuenta si se puede crear el archivo).
+            */
+        bool cabe_tabla(int filas, size_t otros) const;
+
+            /** 
+            @brief Consultora: Indica si caben copias de la tabla de distancias.
+            \pre <em>Cierto.</em>
+            \post estimacion es la memoria del p.i. más la de copias copias de su tabla de distancias, y se devuelve 
+            si cabe en el presupuesto.
+            */
+        bool caben_copias(int copias) const;
 
 
 
@@ -72,10 +271,22 @@ class Cjt_especies {
     //Destructora
 
             /** 
-            @brief Destructora por defecto.
+            @brief Destructora.
+            \post Ha esperado a que acaben las tareas de la tabla del p.i.
             */
         ~Cjt_especies();
 
+            /** 
+            @brief Modificadora: Calcula la tabla de distancias en segundo plano.
+            \pre p existe mientras exista el p.i.
+            \post A partir de ahora, las distancias de la tabla del p.i. se calculan en los hilos de p. 
+            Las consultas que no usan la tabla no esperan a que se acabe de calcular, y las que la usan
+            esperan solo a las filas que necesitan. El resto de etapas paralelas (lectura del conjunto, perfiles,
+            tablas con otro k, vecinos y la búsqueda del mínimo de los clústers que se inicialicen) también se
+            reparten entre los hilos de p.
+            */
+        void usa_pool(Pool_tareas& p);
+
 
     //Consultora
 
@@ -89,9 +300,10 @@ class Cjt_especies {
             /** 
             @brief Consultora: Devuelve el gen asociado al identificador.
             \pre La especie existe en el p.i.
-            \post Devuelve el gen asociado al identificador id_especie.
+            \post Devuelve una referencia constante al gen asociado al identificador id_especie (válida hasta
+            la siguiente modificación del p.i.).
             */
-        string obtener_gen(const string& id_especie) const;
+        const string& obtener_gen(const string& id_especie) const;
 
             /** 
             @brief Consultora: Devuelve la distancia entre dos especies.
@@ -100,6 +312,42 @@ class Cjt_especies {
             */
         double distancia_cjt(const string& id_a, const string& id_b) const;
 
+            /** 
+            @brief Consultora: Indica si se pueden calcular distancias con un k.
+            \pre <em>Cierto.</em>
+            \post Indica si todas las especies del p.i. tienen el perfil de k (el k con el que se han creado o uno 
+            de los calculados con perfiles_k).
+            */
+        bool perfil_disponible(int k) const;
+
+            /** 
+            @brief Consultora: Devuelve la distancia entre dos especies con un k concreto.
+            \pre Las dos especies existen en el p.i. y perfil_disponible(k).
+            \post Devuelve la distancia entre las especies id_a y id_b calculada con sus substrings de k carácteres.
+            */
+        double distancia_cjt(const string& id_a, const string& id_b, int k) const;
+
+            /** 
+            @brief Consultora: Memoria estimada en la última comprobación del presupuesto.
+            \pre <em>Cierto.</em>
+            \post Devuelve los bytes que necesitaba la última operación que ha comprobado el presupuesto de memoria.
+            */
+        size_t memoria_estimada() const;
+
+            /** 
+            @brief Consultora: Devuelve el presupuesto de memoria.
+            \pre <em>Cierto.</em>
+            \post Devuelve el presupuesto de memoria del p.i. en bytes (0 si no tiene).
+            */
+        size_t consultar_presupuesto() const;
+
+            /** 
+            @brief Consultora: Devuelve el alfabeto del conjunto.
+            \pre <em>Cierto.</em>
+            \post Devuelve el alfabeto con el que se calculan los perfiles de las especies del p.i.
+            */
+        Alfabeto consultar_alfabeto() const;
+
 
     //Modificadora
 
@@ -107,9 +355,10 @@ class Cjt_especies {
             @brief Modificadora: Acción que añade la especie al conjunto del p.i.
             \pre La especie no existe en el conjunto.
             \post La especie pasa a tener los atributos leídos en el programa principal (se calculan también los 
-            substrings asociados a las divisiones en k de su gen) y se añade al p.i. 
+            substrings asociados a las divisiones en k de su gen) y se añade al p.i. moviéndola, sin copiar su contenido.
+            Si su alfabeto no es el del p.i., sus perfiles se recalculan con el del p.i.
             */
-        void crea_especie(const Especie& e);
+        void crea_especie(Especie&& e);
 
             /**
             @brief Modificadora: Acción que elimina una especie del conjunto de especies.
@@ -121,39 +370,200 @@ class Cjt_especies {
             /** 
             @brief Modificadora: Inicializa un conjunto de clústers con las especies del p.i.
             \pre <em>Cierto.</em>
-            \post Se han inicializado un conjunto de clústers con las especies del p.i.
+            \post Devuelve si la copia de la tabla de distancias cabe en el presupuesto de memoria; si no, clu no cambia.
+            En caso afirmativo, se han inicializado un conjunto de clústers con las especies del p.i.
             Cada especie ha formado un clúster individual con distancia=-1 (no existe la distancia con ellos mismos). 
             Ha inicializado también, la tabla de distancias de los diferentes clústers (al inicio, está tabla tomará 
             los valores de las distancias entre las especies del conjunto).
             */
-        void inicializa_clusters(Cjt_clusters& clu);
+        bool inicializa_clusters(Cjt_clusters& clu);
+
+            /** 
+            @brief Modificadora: Inicializa un conjunto de clústers con las especies del p.i. y un k concreto.
+            \pre perfil_disponible(k).
+            \post Igual que inicializa_clusters(clu), pero la tabla de distancias inicial de los clústers se calcula 
+            con los substrings de k carácteres de las especies (el presupuesto debe admitir dos copias de la tabla: la
+            calculada y la de clu). La tabla del p.i. no cambia.
+            */
+        bool inicializa_clusters(Cjt_clusters& clu, int k) const;
+
+            /** 
+            @brief Modificadora: Añade una especie al árbol filogenético de un conjunto de clústers.
+            \pre La especie id_especie existe en el p.i. y no está en clu; clu tiene el árbol construido.
+            \post Devuelve si todas las especies del árbol de clu existen en el p.i. En caso afirmativo, se ha añadido 
+            id_especie al árbol de clu de forma incremental (Cjt_clusters::inserta_especie), con las distancias de
+            la tabla del p.i.
+            */
+        bool inserta_en_clusters(Cjt_clusters& clu, const string& id_especie);
+
+            /** 
+            @brief Modificadora: Calcula los perfiles de varios k.
+            \pre Los elementos de nuevos_ks son positivos.
+            \post Todas las especies del p.i., y las que se añadan a partir de ahora, tienen el perfil de cada k de 
+            nuevos_ks. Cada especie calcula los perfiles que le faltan con una sola pasada por su gen; las especies
+            se reparten entre varios hilos.
+            */
+        void perfiles_k(const vector<int>& nuevos_ks);
+
+            /** 
+            @brief Modificadora: Cambia la representación de las distancias de la tabla.
+            \pre <em>Cierto.</em>
+            \post La tabla de distancias del p.i. (y la de los clústers que se inicialicen a partir de él) guarda 
+            las distancias con la representación m. La tabla se ha recalculado.
+            */
+        void cambia_modo_tabla(Modo_tabla m);
+
+            /** 
+            @brief Modificadora: Guarda la tabla de distancias en disco.
+            \pre mb > 0.
+            \post Devuelve si se ha podido crear un archivo temporal en el directorio dir. En caso afirmativo, la tabla 
+            de distancias del p.i. (y la de los clústers que se inicialicen a partir de él) se guarda en un archivo 
+            proyectado en memoria del que solo hay residentes como máximo mb MiB. Si no, la tabla sigue en memoria.
+            La tabla se ha recalculado.
+            */
+        bool tabla_en_disco(const string& dir, int mb);
+
+            /** 
+            @brief Modificadora: Guarda la tabla de distancias en memoria.
+            \pre <em>Cierto.</em>
+            \post La tabla de distancias del p.i. (y la de los clústers que se inicialicen a partir de él) se guarda 
+            en memoria. La tabla se ha recalculado.
+            */
+        void tabla_en_memoria();
+
+            /** 
+            @brief Modificadora: Cambia el motor de las tablas de distancias.
+            \pre <em>Cierto.</em>
+            \post Las tablas de distancias completas del p.i. se calculan con el motor m. La tabla se ha recalculado.
+            */
+        void cambia_motor_tabla(Motor_tabla m);
+
+            /** 
+            @brief Modificadora: Cambia el alfabeto del conjunto.
+            \pre <em>Cierto.</em>
+            \post Los perfiles de las especies del p.i., y los de las que se añadan a partir de ahora, se calculan con el
+            alfabeto a (ver Alfabeto). Si ha cambiado, los perfiles se han recalculado en paralelo, y la tabla de
+            distancias y el índice de vecinos se han reconstruido.
+            */
+        void cambia_alfabeto(Alfabeto a);
+
+            /** 
+            @brief Modificadora: Fija el presupuesto de memoria.
+            \pre <em>Cierto.</em>
+            \post Las especies, sus perfiles y las tablas de distancias del p.i. (y las de los clústers que se
+            inicialicen a partir de él) deben ocupar como mucho mb MiB (0: sin límite). Antes de leer un conjunto de
+            especies y de inicializar clústers se estima la memoria que necesitan: si la tabla no cabe, se guarda
+            con una representación más compacta o, si no basta y dir no está vacío, en un archivo en el directorio 
+            dir; si aun así no cabe, la operación no se hace.
+            */
+        void fija_presupuesto(size_t mb, const string& dir);
 
 
     //Lectura y escritura
 
         /**
             @brief Lectura: Acción que lee un conjunto de especies.
-            \pre Hay preparados en el canal estándar de entrada un entero n ≥ 0 y a continuación una secuencia de n especies 
+            \pre Hay preparados en el canal de entrada in un entero n ≥ 0 y a continuación una secuencia de n especies 
             con sus correspondientes id_especie-gen. No hay id_especies repetidas. Los contenidos previos del conjunto de 
             especies se descartan y las n especies nuevas leídas se agregan al conjunto.
-            \post Se han leído por el canal estándar de entrada el conjunto de especies del parámetro implicito.
+            \post Se han leído por el canal in el conjunto de especies del parámetro implicito. Antes de calcular la
+            tabla se ajusta al presupuesto de memoria (ajusta_tabla), y solo se calculan perfiles mientras las
+            especies caben; si aun así no caben, se devuelve falso y el p.i. queda vacío. Con pool, las especies se leen en cadena
+            (lee_en_cadena): sin presupuesto la tabla se calcula a medida que llegan, con cualquier motor, y con
+            presupuesto se calcula al acabar la lectura, cuando se sabe qué representación cabe.
             */
-        void lee_cjt_especies(const int k);
+        bool lee_cjt_especies(istream& in, const int k);
 
             /**
             @brief Escritura: Acción que imprime un conjunto de especies.
             \pre <em>Cierto.</em>
-            \post Se han escrito por el canal estándar de salida el conjunto de especies del parámetro implicito.
+            \post Se han escrito por el canal out el conjunto de especies del parámetro implicito.
             */
-        void imprime_cjt_especies() const; 
+        void imprime_cjt_especies(ostream& out) const; 
 
             /** 
             @brief Escritura: Acción que imprime la tabla de distancias.
             \pre <em>Cierto.</em>
             No hay pares de especiesrepetidos ni distancias duplicadas. 
-            \post Imprime la tabla de distancias entre cada par de especies del conjunto (p.i.).
+            \post Imprime por el canal out la tabla de distancias entre cada par de especies del conjunto (p.i.).
+            */
+        void tabla_distancias(ostream& out) const;
+
+            /** 
+            @brief Escritura: Acción que imprime la tabla de distancias con un k concreto.
+            \pre perfil_disponible(k).
+            \post Imprime por el canal out, con el mismo formato que tabla_distancias, la tabla de distancias entre 
+            cada par de especies del p.i. calculada con sus substrings de k carácteres.
+            */
+        void tabla_distancias(ostream& out, int k) const;
+
+            /** 
+            @brief Escritura: Acción que compara la tabla de distancias con la de modo DOBLE.
+            \pre <em>Cierto.</em>
+            \post Imprime por el canal out la desviación máxima de las distancias de la tabla del p.i. y de las alturas del árbol 
+            filogenético respecto a las obtenidas en modo DOBLE, e indica si el orden de las fusiones es el mismo.
+            */
+        void precision_tabla(ostream& out) const;
+
+            /** 
+            @brief Escritura: Acción que imprime las distancias de una lista de pares de especies.
+            \pre <em>Cierto.</em>
+            \post Se ha escrito por el canal out, de una sola vez y en el orden de pares, una línea por par 
+            con su distancia o con el error correspondiente si alguna de las dos especies no existe. Cada identificador 
+            se busca una única vez en el p.i. y las distancias que no están en la tabla se calculan en paralelo.
+            */
+        void distancias_lote(const vector<pair<string,string> >& pares, ostream& out) const;
+
+            /** 
+            @brief Escritura: Acción que imprime si existen las especies de una lista.
+            \pre <em>Cierto.</em>
+            \post Se ha escrito por el canal out, de una sola vez y en el orden de ids, "SI" o "NO" según 
+            si cada especie existe en el p.i.
+            */
+        void existe_lote(const vector<string>& ids, ostream& out) const;
+
+            /** 
+            @brief Escritura: Acción que imprime las especies cercanas a una especie.
+            \pre La especie id_especie existe en el p.i.
+            \post Se ha escrito por el canal out, de una sola vez, una línea "id (distancia)" por cada otra especie 
+            del p.i. a distancia menor o igual que umbral de id_especie, de menor a mayor distancia (y en orden 
+            lexicográfico si empatan). Las especies se recorren en paralelo y los pares que no pueden quedar por 
+            debajo del umbral se descartan sin acabar de calcular su distancia.
+            */
+        void vecinos(const string& id_especie, double umbral, ostream& out) const;
+
+            /** 
+            @brief Escritura: Acción que imprime las especies más cercanas a una especie.
+            \pre La especie id_especie existe en el p.i.; k > 0.
+            \post Se ha escrito por el canal out, de una sola vez, una línea "id (distancia)" por cada una de las k 
+            especies del p.i. (o menos, si no hay tantas) más cercanas a id_especie, de menor a mayor distancia (y en 
+            orden lexicográfico si empatan). La búsqueda usa el índice de vecinos y calcula la distancia solo con una
+            parte de las especies.
+            */
+        void k_vecinos(const string& id_especie, int k, ostream& out) const;
+
+            /** 
+            @brief Escritura: Acción que imprime el árbol filogenético con el soporte de cada clado (<em>bootstrap</em>).
+            \pre clu tiene el árbol construido; replicas >= 0.
+            \post Devuelve si todas las especies del árbol de clu existen en el p.i. En caso afirmativo, se ha escrito
+            por el canal out el árbol de clu con el porcentaje de las réplicas en que aparece cada clado (ver
+            Soporte_clados::imprime). Cada réplica remuestrea los perfiles de las especies del árbol, sin volver a
+            leer sus genes (Perfiles_compactos::remuestrea), calcula su tabla de distancias y su árbol con wpgma y
+            cuenta sus clados. Las réplicas se reparten entre los hilos; cada hilo tiene su propia memoria de trabajo
+            (perfiles, tabla y recorrido), que reutiliza entre réplicas, y hay tantos hilos como caben en el
+            presupuesto de memoria (al menos uno). El resultado solo depende de semilla, no del número de hilos.
+            */
+        bool bootstrap(const Cjt_clusters& clu, int replicas, unsigned semilla, ostream& out) const;
+
+            /** 
+            @brief Escritura: Acción que imprime la memoria que ocupa cada estructura.
+            \pre <em>Cierto.</em>
+            \post Se ha escrito por el canal out los bytes que ocupan las especies (identificadores, genes y registro),
+            sus perfiles, los perfiles compactos de las tareas de la tabla en curso (con su índice invertido o matriz
+            densa), la tabla de distancias, el índice de vecinos, la tabla y los árboles de clu, el total, la
+            representación de la tabla y el presupuesto de memoria.
             */
-        void tabla_distancias() const;
+        void memoria(ostream& out, const Cjt_clusters& clu) const;
 };
 
 #endif
\ No newline at end of file
@@ -3,44 +3,24 @@
 */
 
 #include "Especie.hh"
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
 
-//Constructoras y destructora
-
-Especie::Especie(){}
-
-Especie::Especie(const string& id_especie, const string& gen, const int k){
-    //Inicializa una especie con el id y el gen de los parámetros pasados por referencia y 
-    //obtiene los kmeros asociados a su gen
-    this->id_especie=id_especie;
-    this->gen=gen;
-
-    obtener_kmer(k);
-}
-
-Especie::~Especie(){}
-
-
-//Consultoras
-
-string Especie::consultar_gen() const{
-    return gen;
-}
-
-string Especie::consultar_id_especie() const{
-    return id_especie;
-}
-
-double Especie::distancia(const Especie& b) const{ 
-
-    map<string,int>::const_iterator it_a = kmer.begin();
-    map<string,int>::const_iterator it_b = b.kmer.begin();
+static double distancia_perfiles(const map<string,int>& a, const map<string,int>& b) {
+    // Distancia entre dos perfiles de substrings: 1 - |a-b| / (|a|+|b|), en tanto por ciento
+    map<string,int>::const_iterator it_a = a.begin();
+    map<string,int>::const_iterator it_b = b.begin();
     double v=0;
     double w=0;
     double top=0;
     double aux=0;
 
-    while (it_a!=kmer.end() and it_b!=b.kmer.end()) {
+    while (it_a!=a.end() and it_b!=b.end()) {
         if ((*it_a).first==(*it_b).first) {
             aux=(*it_a).second-(*it_b).second;
             top+=aux*aux;
@@ -62,13 +42,13 @@ double Especie::distancia(const Especie& b) const{
             ++it_b;
         }
     }
-    while (it_a!=kmer.end()) {
+    while (it_a!=a.end()) {
         top+=(*it_a).second*(*it_a).second;
         v+=(*it_a).second*(*it_a).second;
         ++it_a;
     }
 
-    while (it_b!=b.kmer.end()) {
+    while (it_b!=b.end()) {
         aux=0-(*it_b).second;
         top+=aux*aux;
         w+=(*it_b).second*(*it_b).second;
@@ -83,50 +63,616 @@ double Especie::distancia(const Especie& b) const{
     return ((1-(top/res))*100);
 }
 
+template <int K>
+static double distancia_perfiles_k(const map<string,int>& a, const map<string,int>& b) {
+    // Igual que distancia_perfiles, sabiendo que todos los substrings tienen K carácteres:
+    // la comparación es un memcmp de longitud constante, que el compilador desenrolla
+    map<string,int>::const_iterator it_a = a.begin();
+    map<string,int>::const_iterator it_b = b.begin();
+    double v=0;
+    double w=0;
+    double top=0;
+    double aux=0;
+    while (it_a!=a.end() and it_b!=b.end()) {
+        int comp=memcmp((*it_a).first.data(),(*it_b).first.data(),K);
+        if (comp==0) {
+            aux=(*it_a).second-(*it_b).second;
+            top+=aux*aux;
+            v+=(*it_a).second*(*it_a).second;
+            w+=(*it_b).second*(*it_b).second;
+            ++it_a;
+            ++it_b;
+        }
+        else if (comp<0) {
+            top+=(*it_a).second*(*it_a).second;
+            v+=(*it_a).second*(*it_a).second;
+            ++it_a;
+        }
+        else {
+            aux=0-(*it_b).second;
+            top+=aux*aux;
+            w+=(*it_b).second*(*it_b).second;
+            ++it_b;
+        }
+    }
+    for (; it_a!=a.end(); ++it_a) {
+        top+=(*it_a).second*(*it_a).second;
+        v+=(*it_a).second*(*it_a).second;
+    }
+    for (; it_b!=b.end(); ++it_b) {
+        aux=0-(*it_b).second;
+        top+=aux*aux;
+        w+=(*it_b).second*(*it_b).second;
+    }
+    top=sqrt(top);
+    v = sqrt(v);
+    w = sqrt(w);
+    double res= v + w;
+    return ((1-(top/res))*100);
+}
+
+template <int K, int BITS>
+static bool perfil_codificado(const string& gen, const signed char* codigo, Perfil& kmer) {
+    // Cada substring de K carácteres se codifica con BITS bits por carácter en el entero más estrecho posible;
+    // los códigos se calculan de forma incremental, se ordenan y se cuentan. Devuelve falso (sin tocar kmer)
+    // si el gen tiene algún carácter que no es del alfabeto
+    typedef typename conditional<(BITS*K<=8),uint8_t,typename conditional<(BITS*K<=16),uint16_t,
+            typename conditional<(BITS*K<=32),uint32_t,uint64_t>::type>::type>::type Codigo;
+    const Codigo mascara=Codigo(Codigo(~Codigo(0))>>(8*sizeof(Codigo)-BITS*K));
+    int n=gen.length();
+    vector<Codigo> cod;
+    if (n>=K) cod.reserve(n-K+1);
+    Codigo c=0;
+    // Inv: c contiene los últimos K carácteres (como mucho) anteriores a i; cod, los códigos de los substrings que acaban antes de i
+    for (int i=0; i<n; ++i) {
+        int b=codigo[(unsigned char)gen[i]];
+        if (b<0) return false;
+        c=Codigo(((c<<BITS)|b)&mascara);
+        if (i>=K-1) cod.push_back(c);
+    }
+    // Con punteros: los iteradores del modo de depuración de la biblioteca multiplican el coste de sort
+    Codigo* p=cod.data();
+    int m=cod.size();
+    sort(p,p+m);
+    int diferentes=0;
+    for (int i=0; i<m; ++i) diferentes+= i==0 or p[i]!=p[i-1];
+    kmer.bits=BITS;
+    kmer.k=K;
+    kmer.cod.reserve(diferentes);
+    kmer.rep.reserve(diferentes);
+    // Inv: se han añadido a kmer los códigos de p[0...i-1], en orden
+    for (int i=0; i<m; ) {
+        int j=i;
+        while (j<m and p[j]==p[i]) ++j;
+        kmer.cod.push_back(p[i]);
+        kmer.rep.push_back(j-i);
+        i=j;
+    }
+    return true;
+}
+
+// Tablas de núcleos especializados para cada k de 1 a K_MAX (en la posición k-1), instanciados en tiempo
+// de compilación; para los k mayores se usan los núcleos genéricos. Las de cálculo de substrings son una por
+// número de bits por carácter, hasta el mayor k que cabe en 64 bits
+static const int K_MAX=32;
+typedef bool (*Perfilador)(const string&, const signed char*, Perfil&);
+typedef double (*Distancia)(const map<string,int>&, const map<string,int>&);
+
+template <int BITS, size_t... K>
+static array<Perfilador,sizeof...(K)> perfiladores(index_sequence<K...>) {
+    return {{ &perfil_codificado<K+1,BITS>... }};
+}
+
+template <size_t... K>
+static array<Distancia,sizeof...(K)> distancias(index_sequence<K...>) {
+    return {{ &distancia_perfiles_k<K+1>... }};
+}
+
+static const array<Perfilador,32> PERFILADOR_2=perfiladores<2>(make_index_sequence<32>());
+static const array<Perfilador,16> PERFILADOR_4=perfiladores<4>(make_index_sequence<16>());
+static const array<Perfilador,12> PERFILADOR_5=perfiladores<5>(make_index_sequence<12>());
+static const array<Distancia,K_MAX> DISTANCIA=distancias(make_index_sequence<K_MAX>());
+
+/**
+* Código de cada carácter en un alfabeto: su posición en letras, o -1 si no está. Las letras van en orden, así que
+* el orden de los códigos es el de los substrings.
+*/
+static array<signed char,256> tabla_codigos(const char* letras) {
+    array<signed char,256> t;
+    t.fill(-1);
+    for (int i=0; letras[i]!=0; ++i) t[(unsigned char)letras[i]]=i;
+    return t;
+}
+
+/** @brief Alfabeto empaquetado: letras, código de cada carácter, bits por carácter, mayor k y núcleos de cálculo de
+substrings */
+struct Empaquetado {
+    const char* letras;
+    array<signed char,256> codigo;
+    int bits;
+    int k_max;
+    const Perfilador* perfilador;
+};
+
+/** @brief ADN, IUPAC y PROTEINA, del más estrecho al más ancho */
+static const Empaquetado EMPAQUETADO[3]={
+    {"ACGT",tabla_codigos("ACGT"),2,32,PERFILADOR_2.data()},
+    {"ABCDGHKMNRSTUVWY",tabla_codigos("ABCDGHKMNRSTUVWY"),4,16,PERFILADOR_4.data()},
+    {"*-ABCDEFGHIJKLMNOPQRSTUVWXYZ",tabla_codigos("*-ABCDEFGHIJKLMNOPQRSTUVWXYZ"),5,12,PERFILADOR_5.data()}
+};
+
+/**
+* Representante de cada carácter en un alfabeto reducido: grupos contiene los grupos separados por espacios, y el
+* representante de cada grupo es su primera letra. Los carácteres que no están en ningún grupo no cambian.
+*/
+static array<char,256> tabla_reduccion(const char* grupos) {
+    array<char,256> t;
+    for (int c=0; c<256; ++c) t[c]=char(c);
+    char r=grupos[0];
+    for (int i=0; grupos[i]!=0; ++i) {
+        if (grupos[i]==' ') r=grupos[i+1];
+        else t[(unsigned char)grupos[i]]=r;
+    }
+    return t;
+}
+
+// Grupos de Murphy et al. (2000); las letras ambiguas o poco frecuentes (B, Z, J, U, O) van al grupo de los
+// aminoácidos que representan o a los que se parecen
+static const array<char,256> REDUCCION_MURPHY10=tabla_reduccion("LVIMJ CU A G ST P FYW EDNQBZ KRO H");
+static const array<char,256> REDUCCION_MURPHY4=tabla_reduccion("LVIMCJU AGSTP FYW EDNQKRHBZO");
+
+static const string& texto(const string& gen, Alfabeto a, string& reducido) {
+    // Texto que se divide en substrings: el gen, o en los alfabetos reducidos una copia (en reducido) con cada
+    // aminoácido sustituido por el representante de su grupo
+    if (a!=MURPHY10 and a!=MURPHY4) return gen;
+    const array<char,256>& t= a==MURPHY10 ? REDUCCION_MURPHY10 : REDUCCION_MURPHY4;
+    reducido.resize(gen.size());
+    for (int i=0; i<gen.size(); ++i) reducido[i]=t[(unsigned char)gen[i]];
+    return reducido;
+}
+
+static int empaquetado_de(const string& t, Alfabeto a) {
+    // Alfabeto empaquetado (posición en EMPAQUETADO) en el que se codifica t: el del alfabeto a o, con AUTOMATICO,
+    // el más estrecho en el que cabe; -1 si t tiene algún carácter que no es de ese alfabeto (o de ninguno)
+    int ini= a==IUPAC ? 1 : (a==PROTEINA or a==MURPHY10 or a==MURPHY4) ? 2 : 0;
+    int fin= a==AUTOMATICO ? 3 : ini+1;
+    int e=ini;
+    // Inv: t[0...i-1] cabe en EMPAQUETADO[e] (si e < fin)
+    for (int i=0; i<t.size() and e<fin; ++i) {
+        while (e<fin and EMPAQUETADO[e].codigo[(unsigned char)t[i]]<0) ++e;
+    }
+    return e<fin ? e : -1;
+}
+
+static void cuenta_codigos(vector<uint64_t>& cod, int bits, int k, Perfil& p) {
+    // Perfil de los códigos de cod (con bits bits por carácter y k carácteres): se ordenan y se cuentan
+    uint64_t* c=cod.data();
+    int m=cod.size();
+    sort(c,c+m);
+    int diferentes=0;
+    for (int i=0; i<m; ++i) diferentes+= i==0 or c[i]!=c[i-1];
+    p.bits=bits;
+    p.k=k;
+    p.cod.reserve(diferentes);
+    p.rep.reserve(diferentes);
+    // Inv: se han añadido a p los códigos de c[0...i-1], en orden
+    for (int i=0; i<m; ) {
+        int j=i;
+        while (j<m and c[j]==c[i]) ++j;
+        p.cod.push_back(c[i]);
+        p.rep.push_back(j-i);
+        i=j;
+    }
+}
+
+static bool perfil_empaquetado(const string& t, int k, Alfabeto a, Perfil& kmer) {
+    // Substrings de t con el núcleo empaquetado del alfabeto; AUTOMATICO los prueba del más estrecho al más ancho
+    int ini= a==IUPAC ? 1 : (a==PROTEINA or a==MURPHY10 or a==MURPHY4) ? 2 : 0;
+    int fin= a==AUTOMATICO ? 3 : ini+1;
+    for (int i=ini; i<fin; ++i) {
+        const Empaquetado& e=EMPAQUETADO[i];
+        if (k>=1 and k<=e.k_max and e.perfilador[k-1](t,e.codigo.data(),kmer)) return true;
+    }
+    return false;
+}
+
+string Perfil::substring(uint64_t c, int bits, int k) {
+    const char* letras=EMPAQUETADO[bits==2 ? 0 : bits==4 ? 1 : 2].letras;
+    string s(k,' ');
+    for (int t=0; t<k; ++t) s[t]=letras[(c>>(bits*(k-1-t)))&((1<<bits)-1)];
+    return s;
+}
 
+/**
+* Recorrido en orden de los substrings de un perfil como texto: los códigos se traducen a medida que se visitan,
+* sin reservar memoria (el perfil empaquetado tiene como mucho K_MAX carácteres por substring).
+*/
+struct Lector {
+    const Perfil& p;
+    int i;
+    map<string,int>::const_iterator it;
+    const char* letras;
+    char s[K_MAX];
+
+    Lector(const Perfil& p) : p(p), i(0), it(p.texto.begin()) {
+        letras=EMPAQUETADO[p.bits==2 ? 0 : p.bits==4 ? 1 : 2].letras;
+        traduce();
+    }
+    bool fin() const { return p.bits!=0 ? i==int(p.cod.size()) : it==p.texto.end(); }
+    const char* texto() const { return p.bits!=0 ? s : (*it).first.data(); }
+    int rep() const { return p.bits!=0 ? p.rep[i] : (*it).second; }
+    void avanza() {
+        if (p.bits==0) ++it;
+        else {
+            ++i;
+            traduce();
+        }
+    }
+    void traduce() {
+        if (p.bits==0 or fin()) return;
+        for (int t=0; t<p.k; ++t) s[t]=letras[(p.cod[i]>>(p.bits*(p.k-1-t)))&((1<<p.bits)-1)];
+    }
+};
+
+/**
+* Recorre a la vez los substrings de a y b (del mismo k) en orden y llama a f(ra, rb) para cada substring que está
+* en alguno de los dos, con sus repeticiones en a y en b (0 si no está); si f devuelve falso, el recorrido se
+* acaba y devuelve falso. Con los mismos bits por carácter se comparan los códigos; si no, los substrings.
+*/
+template <class F>
+static bool recorre(const Perfil& a, const Perfil& b, F f) {
+    if (a.bits!=0 and a.bits==b.bits) {
+        // Con punteros: los iteradores del modo de depuración de la biblioteca multiplican el coste de la fusión
+        const uint64_t* ca=a.cod.data();
+        const uint64_t* cb=b.cod.data();
+        const int* ra=a.rep.data();
+        const int* rb=b.rep.data();
+        int na=a.cod.size();
+        int nb=b.cod.size();
+        int i=0;
+        int j=0;
+        // Inv: se han visitado los códigos de a anteriores a i y los de b anteriores a j
+        while (i<na and j<nb) {
+            if (ca[i]==cb[j]) {
+                if (not f(ra[i++],rb[j++])) return false;
+            }
+            else if (ca[i]<cb[j]) {
+                if (not f(ra[i++],0)) return false;
+            }
+            else if (not f(0,rb[j++])) return false;
+        }
+        for (; i<na; ++i) if (not f(ra[i],0)) return false;
+        for (; j<nb; ++j) if (not f(0,rb[j])) return false;
+        return true;
+    }
+    int k=a.bits!=0 ? a.k : b.k;
+    Lector la(a);
+    Lector lb(b);
+    while (not la.fin() and not lb.fin()) {
+        int comp=memcmp(la.texto(),lb.texto(),k);
+        if (comp==0) {
+            if (not f(la.rep(),lb.rep())) return false;
+            la.avanza();
+            lb.avanza();
+        }
+        else if (comp<0) {
+            if (not f(la.rep(),0)) return false;
+            la.avanza();
+        }
+        else {
+            if (not f(0,lb.rep())) return false;
+            lb.avanza();
+        }
+    }
+    for (; not la.fin(); la.avanza()) if (not f(la.rep(),0)) return false;
+    for (; not lb.fin(); lb.avanza()) if (not f(0,lb.rep())) return false;
+    return true;
+}
+
+static double distancia_perfiles(const Perfil& a, const Perfil& b, int k) {
+    // Dos perfiles de texto: núcleo especializado para k, si lo hay
+    if (a.bits==0 and b.bits==0) {
+        if (k>=1 and k<=K_MAX) return DISTANCIA[k-1](a.texto,b.texto);
+        return distancia_perfiles(a.texto,b.texto);
+    }
+    double v=0;
+    double w=0;
+    double top=0;
+    recorre(a,b,[&v,&w,&top](double ra, double rb) {
+        top+=(ra-rb)*(ra-rb);
+        v+=ra*ra;
+        w+=rb*rb;
+        return true;
+    });
+    top=sqrt(top);
+    v = sqrt(v);
+    w = sqrt(w);
+    double res= v + w;
+    return ((1-(top/res))*100);
+}
+
+/**
+* Bytes de memoria dinámica de un string: ninguno si su contenido cabe dentro del propio objeto (optimización
+* de strings cortos), o su capacidad más el carácter final.
+*/
+static size_t bytes_string(const string& s) {
+    const char* o=reinterpret_cast<const char*>(&s);
+    if (s.data()>=o and s.data()<o+sizeof(s)) return 0;
+    return s.capacity()+1;
+}
+
+/**
+* Bytes de un nodo de un map con valores de tipo V: los tres punteros y el color del árbol, más el valor.
+*/
+template <class V> static size_t bytes_nodo() {
+    return 4*sizeof(void*)+sizeof(V);
+}
+
+static size_t bytes_perfil(const Perfil& p) {
+    size_t b=p.cod.capacity()*sizeof(uint64_t)+p.rep.capacity()*sizeof(int);
+    b+=p.texto.size()*bytes_nodo<pair<const string,int> >();
+    for (map<string,int>::const_iterator it=p.texto.begin(); it!=p.texto.end(); ++it) b+=bytes_string((*it).first);
+    return b;
+}
+
+//Constructoras y destructora
+
+Especie::Especie(){
+    k=0;
+    alfabeto=AUTOMATICO;
+    norma2=0;
+    memoria_perfiles=0;
+}
+
+Especie::Especie(string id_especie, string gen, const int k, Alfabeto a){
+    //Inicializa una especie moviendo el id y el gen de los parámetros y 
+    //obtiene los kmeros asociados a su gen
+    this->id_especie=move(id_especie);
+    this->gen=move(gen);
+    alfabeto=a;
+
+    obtener_kmer(k);
+    cuenta_memoria();
+}
+
+Especie::~Especie(){}
+
+
+//Consultoras
+
+const string& Especie::consultar_gen() const{
+    return gen;
+}
+
+const string& Especie::consultar_id_especie() const{
+    return id_especie;
+}
+
+const Perfil& Especie::consultar_kmer() const{
+    return kmer;
+}
+
+double Especie::distancia(const Especie& b) const{ 
+    return distancia_perfiles(kmer,b.kmer,k);
+}
+
+double Especie::norma() const{
+    return sqrt(norma2);
+}
+
+double Especie::distancia_euclidea(const Especie& b) const{
+    // Suma de los cuadrados de las diferencias, en el mismo orden que distancia_perfiles
+    double top=0;
+    recorre(kmer,b.kmer,[&top](double ra, double rb) {
+        top+=(ra-rb)*(ra-rb);
+        return true;
+    });
+    return sqrt(top);
+}
+
+bool Especie::distancia_hasta(const Especie& b, double umbral, double& d) const{
+    // d <= umbral si y solo si |a-b|^2 >= c^2 (|a|+|b|)^2, con c = 1 - umbral/100.
+    // Como |a-b|^2 = |a|^2 + |b|^2 - 2 a·b y cada substring común solo hace crecer a·b, la cota
+    // |a|^2 + |b|^2 - 2 (a·b parcial) solo puede bajar durante la fusión: cuando queda por debajo, se descarta.
+    // Todas las sumas son enteras (exactas en double); el margen absorbe el redondeo de la cota.
+    double c=1-umbral/100;
+    if (c<=0) {
+        d=distancia(b);
+        return d<=umbral;
+    }
+    double v=sqrt(norma2);
+    double w=sqrt(b.norma2);
+    double lim=c*c*(v+w)*(v+w)*(1-1e-9);
+    double cota=norma2+b.norma2;
+    if (cota<lim) return false;
+
+    // Inv: cota = |a|^2 + |b|^2 - 2 (producto de los substrings comunes visitados) >= lim
+    bool sigue=recorre(kmer,b.kmer,[&cota,lim](double ra, double rb) {
+        cota-=2.0*ra*rb;
+        return cota>=lim;
+    });
+    if (not sigue) return false;
+    d=distancia(b);
+    return d<=umbral;
+}
+
+bool Especie::tiene_perfil(int k) const{
+    return k==this->k or perfiles.count(k)>0;
+}
+
+const Perfil& Especie::perfil(int k) const{
+    if (k==this->k) return kmer;
+    return perfiles.find(k)->second;
+}
+
+double Especie::distancia(const Especie& b, int k) const{
+    return distancia_perfiles(perfil(k),b.perfil(k),k);
+}
+
+Alfabeto Especie::consultar_alfabeto() const{
+    return alfabeto;
+}
+
+size_t Especie::bytes_gen() const{
+    return bytes_string(id_especie)+bytes_string(gen);
+}
+
+size_t Especie::bytes_perfiles() const{
+    return memoria_perfiles;
+}
+
+size_t Especie::estima_bytes_perfil(size_t largo, int k) {
+    if (largo<k) return 0;
+    string s(k,' ');
+    return (largo-k+1)*(bytes_nodo<pair<const string,int> >()+bytes_string(s));
+}
 
 
 //Modificadora
 
 void Especie::obtener_kmer(const int k) {  
+    this->k=k;
+    kmer=Perfil();
+    kmer.k=k;
+    string reducido;
+    const string& t=texto(gen,alfabeto,reducido);
+    if (perfil_empaquetado(t,k,alfabeto,kmer)) {
+        calcula_norma();
+        return;
+    }
     // Tratamos de obtener el conjunto de substrings que forman las divisiones del gen en k 
     // divisiones de la especie del p.i.
 
     // Inv: Los carácteres posteriores a i no se han visitado. Se han generado substrings para
     // las i anteriores de la forma: i+k-1
-    for (int i=0; i<gen.length()-k+1; ++i) {
+    for (int i=0; i+k<=t.length(); ++i) {
         string aux="";
         // Inv: j<k. 
         // Se han concatenado los valores anteriores a j 
         for (int j=i; j<k+i; ++j) {
-            aux+=gen[j];
+            aux+=t[j];
         }
-        if (i==0) kmer.insert(make_pair(aux,1));
+        if (i==0) kmer.texto.insert(make_pair(aux,1));
         else {
             map<string,int>::iterator it;
-            it=kmer.find(aux);
-            if (it != kmer.end()) (*it).second +=1;
-            else kmer.insert(make_pair(aux,1));
+            it=kmer.texto.find(aux);
+            if (it != kmer.texto.end()) (*it).second +=1;
+            else kmer.texto.insert(make_pair(aux,1));
         }
         // Post: aux tiene el valor concatenado de j+k-1. Se ha añadido a kmer el pair aux que 
         // toma el valor del substring generado junto con sus repeticiones desde i=0 hasta la i actual
     }
     // Post: se han generado todos los substrings posibles y se han añadido de forma correcta al kmer
-    // hasta i=gen.length()-k+1
+    // hasta i=t.length()-k+1
+    calcula_norma();
+}
+
+void Especie::calcula_norma() {
+    norma2=0;
+    for (int i=0; i<kmer.rep.size(); ++i) norma2+=double(kmer.rep[i])*kmer.rep[i];
+    for (map<string,int>::const_iterator it=kmer.texto.begin(); it!=kmer.texto.end(); ++it) norma2+=double((*it).second)*(*it).second;
+}
+
+void Especie::cuenta_memoria() {
+    memoria_perfiles=bytes_perfil(kmer);
+    for (map<int,Perfil>::const_iterator it=perfiles.begin(); it!=perfiles.end(); ++it) {
+        memoria_perfiles+=bytes_nodo<pair<const int,Perfil> >()+bytes_perfil((*it).second);
+    }
+}
+
+
+void Especie::calcula_perfiles(const vector<int>& ks) {
+    // Perfiles que faltan, de menor a mayor k
+    vector<int> nuevos;
+    for (int i=0; i<ks.size(); ++i) {
+        if (not tiene_perfil(ks[i])) nuevos.push_back(ks[i]);
+    }
+    sort(nuevos.begin(),nuevos.end());
+    nuevos.erase(unique(nuevos.begin(),nuevos.end()),nuevos.end());
+    if (nuevos.empty()) return;
+
+    string reducido;
+    const string& g=texto(gen,alfabeto,reducido);
+    int n=g.length();
+    // Los k que caben en 64 bits con el alfabeto empaquetado del gen se cuentan con códigos (en emp); los demás,
+    // como texto (en nuevos)
+    int e=empaquetado_de(g,alfabeto);
+    int bits= e>=0 ? EMPAQUETADO[e].bits : 0;
+    vector<int> emp;
+    vector<int> de_texto;
+    for (int t=0; t<nuevos.size(); ++t) {
+        if (e>=0 and nuevos[t]<=EMPAQUETADO[e].k_max) emp.push_back(nuevos[t]);
+        else de_texto.push_back(nuevos[t]);
+    }
+    nuevos.swap(de_texto);
+    vector<vector<uint64_t> > cod(emp.size());
+    vector<uint64_t> mascara(emp.size());
+    for (int t=0; t<emp.size(); ++t) {
+        if (n>=emp[t]) cod[t].reserve(n-emp[t]+1);
+        mascara[t]= bits*emp[t]==64 ? ~uint64_t(0) : (uint64_t(1)<<(bits*emp[t]))-1;
+    }
+    vector<map<string,int>*> p(nuevos.size());
+    for (int t=0; t<nuevos.size(); ++t) p[t]=&perfiles[nuevos[t]].texto;
+    const signed char* codigo= e>=0 ? EMPAQUETADO[e].codigo.data() : 0;
+    uint64_t c=0;
+    string aux;
+    // Una sola pasada por el gen: en cada posición i, el código de los últimos carácteres (una ventana compartida
+    // por todos los k empaquetados) da el substring de cada k que acaba en i, y el substring que empieza en i da
+    // los de texto
+    // Inv: c contiene los códigos de los últimos carácteres anteriores a i (tantos como caben en 64 bits); se han
+    // contado los substrings empaquetados que acaban antes de i y los de texto que empiezan antes de i
+    for (int i=0; i<n; ++i) {
+        if (not emp.empty()) {
+            c=(c<<bits)|uint64_t(codigo[(unsigned char)g[i]]);
+            for (int t=0; t<emp.size(); ++t) {
+                if (i>=emp[t]-1) cod[t].push_back(c&mascara[t]);
+            }
+        }
+        aux.clear();
+        int t=0;
+        // Inv: aux es el substring de longitud j-i que empieza en i, y se han contado los de los k de nuevos[0...t-1]
+        for (int j=i; j<n and t<nuevos.size(); ++j) {
+            aux+=g[j];
+            if (aux.length()==nuevos[t]) {
+                ++(*p[t])[aux];
+                ++t;
+            }
+        }
+    }
+    for (int t=0; t<emp.size(); ++t) {
+        Perfil& q=perfiles[emp[t]];
+        cuenta_codigos(cod[t],bits,emp[t],q);
+    }
+    for (int t=0; t<nuevos.size(); ++t) perfiles[nuevos[t]].k=nuevos[t];
+    // Post: cada perfil nuevo contiene todos los substrings del gen de su longitud con sus repeticiones
+    cuenta_memoria();
+}
+
+void Especie::cambia_alfabeto(Alfabeto a) {
+    // Recalcula el perfil de k y los adicionales con el nuevo alfabeto
+    alfabeto=a;
+    vector<int> ks;
+    for (map<int,Perfil>::const_iterator it=perfiles.begin(); it!=perfiles.end(); ++it) ks.push_back((*it).first);
+    perfiles.clear();
+    obtener_kmer(k);
+    calcula_perfiles(ks);
+    cuenta_memoria();
 }
 
 
 //Lectura y escitura
 
-void Especie::lee_especie(const int k) {
+void Especie::lee_especie(istream& in, const int k, Alfabeto a) {
     //Lee una especie y obtiene el map de substrings asociados al gen en k carácteres
-    cin>>id_especie>>gen;
+    in>>id_especie>>gen;
+    alfabeto=a;
     obtener_kmer(k);
+    cuenta_memoria();
 }
 
-void Especie::imprime_especie() const {
+void Especie::imprime_especie(ostream& out) const {
     //Imprime una especie
-    cout<<id_especie<<" "<<gen<<endl;
+    out<<id_especie<<" "<<gen<<endl;
 }
 
 
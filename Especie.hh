@@ -5,11 +5,50 @@
 #ifndef ESPECIE_HH
 #define ESPECIE_HH
 #ifndef NO_DIAGRAM
+#include <cstdint>
 #include <iostream>
 #include <map>
+#include <string>
+#include <vector>
 #endif
 using namespace std;
 
+/** @brief Alfabeto de los genes de un conjunto de especies.
+    Con los alfabetos ADN (A, C, G, T), IUPAC (los 16 códigos de nucleótidos de IUPAC, U incluida) y PROTEINA (las
+    26 letras, '*' y '-'), los substrings se calculan codificando cada carácter con 2, 4 o 5 bits; un gen con otros
+    carácteres se trata como un texto cualquiera, con el mismo resultado. AUTOMATICO escoge para cada gen el más
+    estrecho de los tres en el que cabe. MURPHY10 y MURPHY4 son alfabetos reducidos de proteínas: antes de dividir
+    el gen en substrings, cada aminoácido se sustituye por el representante de su grupo (10 o 4 grupos, según
+    Murphy et al., 2000), de modo que las sustituciones entre aminoácidos parecidos no cambian los perfiles.
+*/
+enum Alfabeto { AUTOMATICO, ADN, IUPAC, PROTEINA, MURPHY10, MURPHY4 };
+
+/** @brief Perfil de un gen: sus substrings de k carácteres junto con sus repeticiones.
+    Si el texto del gen cabe en un alfabeto empaquetado (ver Alfabeto) y k en 64 bits, cada substring se guarda como
+    su código entero, con bits bits por carácter, en cod (de menor a mayor, que es el orden de los substrings) y sus
+    repeticiones en rep. Si no, bits es 0 y los substrings se guardan como texto en el map texto.
+*/
+struct Perfil {
+    /** @brief Bits por carácter de los códigos (2, 4 o 5), o 0 si los substrings se guardan como texto */
+    int bits;
+    /** @brief Número de carácteres de los substrings */
+    int k;
+    /** @brief Códigos de los substrings, de menor a mayor */
+    vector<uint64_t> cod;
+    /** @brief Repeticiones de cada código */
+    vector<int> rep;
+    /** @brief Substrings con sus repeticiones, si bits es 0 */
+    map<string,int> texto;
+
+    Perfil() : bits(0), k(0) {}
+
+    /** @brief Número de substrings diferentes */
+    int num_substrings() const { return bits!=0 ? int(cod.size()) : int(texto.size()); }
+
+    /** @brief Substring de k carácteres del código c con bits bits por carácter */
+    static string substring(uint64_t c, int bits, int k);
+};
+
 /*
 * Clase Especie
 */
@@ -24,6 +63,14 @@ using namespace std;
     entre el parámetro implícito y otra especie y métodos básicos de consulta, lectura y escritura.
     Se crea una constructora con la k para poder llamar a esta constructora desde el conjunto de especies; 
     de esta forma podemos añadir la función relacionada con la división del gen entre k carácteres en la parte privada.
+
+    Para cada alfabeto empaquetado (ver Alfabeto) y cada k hasta el máximo que cabe en 64 bits (32 con ADN, 16 con
+    IUPAC y 12 con PROTEINA) hay núcleos especializados en tiempo de compilación que codifican los substrings con 2,
+    4 o 5 bits por carácter en el entero más estrecho que cabe; se escogen con una tabla por alfabeto indexada por k.
+    El perfil guarda los códigos (ver Perfil) y la distancia entre dos perfiles con los mismos bits por carácter
+    compara enteros. Los genes con otros carácteres y los k mayores guardan los substrings como texto, y su
+    distancia los compara con una longitud constante (hasta k = 32); entre perfiles con bits diferentes, los
+    códigos se traducen a texto durante el recorrido. El resultado es el mismo en todos los casos.
 */
 
 class Especie {
@@ -34,16 +81,42 @@ class Especie {
         /** @brief Gen de la especie */
         string gen; 
         /** @brief Conjunto de substrings generados al dividir el gen de la especie en k carácteres junto con sus repeticiones */
-        map<string,int> kmer;
+        Perfil kmer;
+        /** @brief Suma de los cuadrados de las repeticiones de kmer (cuadrado de su norma) */
+        double norma2;
+        /** @brief k con el que se ha calculado kmer */
+        int k;
+        /** @brief Alfabeto con el que se han calculado kmer y perfiles */
+        Alfabeto alfabeto;
+        /** @brief Perfiles adicionales: para cada valor de k diferente del anterior, los substrings del gen 
+        divididos en k carácteres junto con sus repeticiones */
+        map<int,Perfil> perfiles;
+        /** @brief Bytes de memoria dinámica que ocupan kmer y perfiles (se cuentan cada vez que se calculan) */
+        size_t memoria_perfiles;
 
             /** 
             @brief Modificadora: Calcula los substrings del gen divididos en k carácteres.
             \pre <em>Cierto.</em>
             \post Rellena la información del p.i. con los substrings del gen divididos en k carácteres junto 
-            con un <em>integer</em> que indica las repeticiones de cada substring diferente del gen.
+            con un <em>integer</em> que indica las repeticiones de cada substring diferente del gen (reducido, si
+            el alfabeto del p.i. es reducido).
             */
         void obtener_kmer(const int k);    
-        
+
+            /** 
+            @brief Modificadora: Calcula la norma del perfil.
+            \pre <em>Cierto.</em>
+            \post norma2 es la suma de los cuadrados de las repeticiones de kmer.
+            */
+        void calcula_norma();
+
+            /** 
+            @brief Modificadora: Cuenta la memoria de los perfiles.
+            \pre <em>Cierto.</em>
+            \post memoria_perfiles es la estimación de los bytes que ocupan kmer y perfiles.
+            */
+        void cuenta_memoria();
+
 
     public:
 
@@ -58,10 +131,35 @@ class Especie {
             /** 
             @brief Creadora con identificador y gen.
             \pre <em>Cierto. </em>
-            \post Crea una especie con los parámetros pasados por referencia de la función del identificador y el gen.
-            Rellena la información del p.i. con los substrings asociados al gen divididos en k carácteres.
+            \post Crea una especie con el identificador y el gen de los parámetros, que se mueven al p.i.
+            Rellena la información del p.i. con los substrings asociados al gen divididos en k carácteres, con el
+            alfabeto a.
             */   
-        Especie(const string& id_especie, const string& gen, const int k);
+        Especie(string id_especie, string gen, const int k, Alfabeto a=AUTOMATICO);
+
+            /** 
+            @brief Creadora de copia.
+            \pre <em>Cierto. </em>
+            \post Crea una copia de la especie e (incluidos sus substrings).
+            */   
+        Especie(const Especie& e) = default;
+
+            /** 
+            @brief Creadora por movimiento.
+            \pre <em>Cierto. </em>
+            \post Crea una especie con el contenido de e, sin copiarlo. e queda en un estado válido pero indefinido.
+            */   
+        Especie(Especie&& e) = default;
+
+            /** 
+            @brief Asignación de copia.
+            */   
+        Especie& operator=(const Especie& e) = default;
+
+            /** 
+            @brief Asignación por movimiento.
+            */   
+        Especie& operator=(Especie&& e) = default;
 
 
     //Destructora
@@ -75,16 +173,31 @@ class Especie {
             /** 
             @brief Consultora: Consulta el gen asociado a la especie.
             \pre <em>Cierto. </em>
-            \post Devuelve el gen asociado a una especie.
+            \post Devuelve una referencia constante al gen asociado a una especie (válida mientras exista el p.i.).
             */
-        string consultar_gen() const;
+        const string& consultar_gen() const;
         
             /** 
             @brief Consultora: Consulta el identificador asociado a la especie.
             \pre <em>Cierto. </em>
-            \post Devuelve el identificador asociado a una especie.
+            \post Devuelve una referencia constante al identificador asociado a una especie (válida mientras exista el p.i.).
+            */
+        const string& consultar_id_especie() const;
+
+            /** 
+            @brief Consultora: Devuelve los substrings del gen divididos en k carácteres.
+            \pre <em>Cierto. </em>
+            \post Devuelve una referencia constante a los substrings del gen del p.i. (con el k con el que se ha 
+            creado) junto con sus repeticiones.
             */
-        string consultar_id_especie() const;
+        const Perfil& consultar_kmer() const;
+
+            /** 
+            @brief Consultora: Devuelve los substrings del gen divididos en k carácteres con un k concreto.
+            \pre El p.i. tiene el perfil de k.
+            \post Devuelve una referencia constante al perfil de k del p.i.
+            */
+        const Perfil& perfil(int k) const;
 
             /**
             @brief Consultora: Determina la distancia entre dos especies.
@@ -94,22 +207,112 @@ class Especie {
             */ 
         double distancia(const Especie& b) const;
 
+            /**
+            @brief Consultora: Norma del perfil de la especie.
+            \pre <em>Cierto. </em>
+            \post Devuelve la norma euclídea del vector de repeticiones de los substrings del p.i.
+            */ 
+        double norma() const;
+
+            /**
+            @brief Consultora: Distancia euclídea entre los perfiles de dos especies.
+            \pre <em>Cierto. </em>
+            \post Devuelve la norma de la diferencia entre los vectores de repeticiones de los substrings del p.i. 
+            y de b. A diferencia de distancia, es una métrica; se cumple que 
+            distancia(b) = (1 - distancia_euclidea(b) / (norma() + b.norma())) * 100.
+            */ 
+        double distancia_euclidea(const Especie& b) const;
+
+            /**
+            @brief Consultora: Determina si la distancia entre dos especies no supera un umbral.
+            \pre Ambas especies existen y tienen un gen asociado. 
+            \post Indica si la distancia entre la especie del p.i. y la especie b es menor o igual que umbral; en
+            caso afirmativo, d es esa distancia. Con las normas de los dos perfiles se descartan los pares que
+            no pueden quedar por debajo del umbral sin recorrerlos, o en cuanto los substrings comunes ya lo
+            impiden, sin acabar el recorrido.
+            */ 
+        bool distancia_hasta(const Especie& b, double umbral, double& d) const;
+
+            /**
+            @brief Consultora: Indica si la especie tiene el perfil de un k.
+            \pre <em>Cierto. </em>
+            \post Indica si se han calculado los substrings del gen del p.i. divididos en k carácteres.
+            */ 
+        bool tiene_perfil(int k) const;
+
+            /**
+            @brief Consultora: Determina la distancia entre dos especies con un k concreto.
+            \pre Ambas especies tienen el perfil de k.
+            \post Devuelve la distancia entre la especie del p.i. y la especie b calculada con los substrings
+            del gen divididos en k carácteres.
+            */ 
+        double distancia(const Especie& b, int k) const;
+
+            /**
+            @brief Consultora: Alfabeto de la especie.
+            \pre <em>Cierto. </em>
+            \post Devuelve el alfabeto con el que se han calculado los perfiles del p.i.
+            */ 
+        Alfabeto consultar_alfabeto() const;
+
+            /**
+            @brief Consultora: Memoria del identificador y del gen.
+            \pre <em>Cierto. </em>
+            \post Devuelve los bytes de memoria dinámica que ocupan el identificador y el gen del p.i.
+            */ 
+        size_t bytes_gen() const;
+
+            /**
+            @brief Consultora: Memoria de los perfiles.
+            \pre <em>Cierto. </em>
+            \post Devuelve la estimación de los bytes de memoria dinámica que ocupan los perfiles del p.i. (el de
+            su k y los calculados con calcula_perfiles), contados al calcularlos.
+            */ 
+        size_t bytes_perfiles() const;
+
+            /**
+            @brief Consultora: Estimación de la memoria de un perfil antes de calcularlo.
+            \pre k > 0.
+            \post Devuelve una cota superior de los bytes que ocupará el perfil de k de un gen de longitud largo
+            (como si todos sus substrings fueran diferentes).
+            */ 
+        static size_t estima_bytes_perfil(size_t largo, int k);
+
+
+    //Modificadora
+            /**
+            @brief Modificadora: Calcula los perfiles de varios k.
+            \pre Los elementos de ks son positivos.
+            \post El p.i. tiene el perfil de cada k de ks. Los que faltaban se han calculado con una sola pasada por
+            el gen. Los k que caben en 64 bits con el alfabeto empaquetado del gen comparten una ventana con el código
+            de los últimos carácteres, de la que cada uno toma los bits de su substring; para los demás, en cada
+            posición se construye una sola vez el substring del mayor k y los de los demás son sus prefijos.
+            */ 
+        void calcula_perfiles(const vector<int>& ks);
+
+            /**
+            @brief Modificadora: Cambia el alfabeto de la especie.
+            \pre <em>Cierto.</em>
+            \post Los perfiles del p.i. (el de su k y los de calcula_perfiles) se han recalculado con el alfabeto a.
+            */ 
+        void cambia_alfabeto(Alfabeto a);
+
 
     //Lectura y escritura
             /**
             @brief Lectura: Acción que lee una especie.
-            \pre Hay preparados en el canal estándar de entrada un identificador y un gen.
-            \post Se ha leído por el canal estándar de entrada el identificador y el gen del p.i. y se ha calculado
-            la información de todos los substrings del gen en k carácteres del p.i.
+            \pre Hay preparados en el canal de entrada in un identificador y un gen.
+            \post Se ha leído por el canal in el identificador y el gen del p.i. y se ha calculado
+            la información de todos los substrings del gen en k carácteres del p.i., con el alfabeto a.
             */
-        void lee_especie(const int k);
+        void lee_especie(istream& in, const int k, Alfabeto a=AUTOMATICO);
 
             /**
             @brief Escritura: Acción que imprime una especie.
             \pre <em>Cierto.</em>
-            \post Se ha escrito por el canal estándar de salida la especie del p.i.
+            \post Se ha escrito por el canal out la especie del p.i.
             */
-        void imprime_especie() const;      
+        void imprime_especie(ostream& out) const;      
 };
 
 #endif 
@@ -0,0 +1,242 @@
+/** @file Indice_vecinos.cc
+    @brief Código de la clase Indice_vecinos
+*/
+
+#include "Indice_vecinos.hh"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const int Indice_vecinos::TAM_HOJA;
+
+static double angulo(const Especie& a, const Especie& b, double& d) {
+    // Ángulo entre los perfiles de a y b (a partir de E^2 = |a|^2 + |b|^2 - 2 a·b); d es la distancia entre a y b
+    double e=a.distancia_euclidea(b);
+    double na=a.norma();
+    double nb=b.norma();
+    d=(1-(e/(na+nb)))*100;
+    if (na==0 or nb==0) return M_PI/2;
+    double c=(na*na+nb*nb-e*e)/(2*na*nb);
+    return acos(max(-1.0,min(1.0,c)));
+}
+
+//Constructora y destructora
+
+Indice_vecinos::Indice_vecinos() {
+    raiz=-1;
+    valido=false;
+}
+
+Indice_vecinos::~Indice_vecinos(){}
+
+
+//Consultoras
+
+bool Indice_vecinos::es_valido() const {
+    return valido;
+}
+
+size_t Indice_vecinos::bytes() const {
+    size_t b=nodos.capacity()*sizeof(Nodo);
+    for (int i=0; i<nodos.size(); ++i) b+=nodos[i].hoja.capacity()*sizeof(int);
+    return b;
+}
+
+double Indice_vecinos::cota(int nodo, double nq, double ang_max) const {
+    // Para x del subárbol, con l = |x|/|q| y c = cos(ang(q,x)) >= cos(min(ang_max, pi/2)):
+    // (E/(|q|+|x|))^2 = (1 + l^2 - 2lc) / (1+l)^2, que crece al alejarse l de 1, así que el máximo
+    // está en uno de los extremos de [norma_min, norma_max] / |q|
+    if (nq==0) return 0;
+    double c=cos(min(ang_max+1e-6,M_PI/2));
+    double r2=0;
+    double l[2]={nodos[nodo].norma_min/nq,nodos[nodo].norma_max/nq};
+    for (int i=0; i<2; ++i) r2=max(r2,(1+l[i]*l[i]-2*l[i]*c)/((1+l[i])*(1+l[i])));
+    return (1-sqrt(min(1.0,r2)))*100;
+}
+
+void Indice_vecinos::busca(const Registro_especies& r, int nodo, const Especie& q, int fq, int k,
+                           priority_queue<Candidato>& mejores) const {
+    const Nodo& x=nodos[nodo];
+    double nq=q.norma();
+    if (x.vp<0) {
+        // Inv: se han considerado las especies de la hoja anteriores a i
+        for (int i=0; i<x.hoja.size(); ++i) {
+            if (x.hoja[i]!=fq) {
+                const Especie& e=r.consultar(x.hoja[i]);
+                Candidato c(q.distancia(e),e.consultar_id_especie());
+                if (mejores.size()<k) mejores.push(c);
+                else if (c<mejores.top()) {
+                    mejores.pop();
+                    mejores.push(c);
+                }
+            }
+        }
+        return;
+    }
+
+    const Especie& p=r.consultar(x.vp);
+    double d;
+    double t=angulo(q,p,d);
+    if (x.vp!=fq) {
+        Candidato c(d,p.consultar_id_especie());
+        if (mejores.size()<k) mejores.push(c);
+        else if (c<mejores.top()) {
+            mejores.pop();
+            mejores.push(c);
+        }
+    }
+
+    // Se visita primero el hijo con la cota más baja; un hijo se descarta si su cota supera el peor de los
+    // k mejores (con un margen para el redondeo de la cota)
+    double inf=numeric_limits<double>::infinity();
+    pair<double,int> hijo[2];
+    hijo[0]=make_pair(x.dentro>=0 ? cota(x.dentro,nq,t+x.mu) : inf,x.dentro);
+    hijo[1]=make_pair(x.fuera>=0 ? cota(x.fuera,nq,t+x.radio) : inf,x.fuera);
+    if (hijo[1].first<hijo[0].first) swap(hijo[0],hijo[1]);
+    for (int i=0; i<2; ++i) {
+        if (hijo[i].second>=0 and (mejores.size()<k or hijo[i].first<=mejores.top().first+1e-7)) {
+            busca(r,hijo[i].second,q,fq,k,mejores);
+        }
+    }
+}
+
+void Indice_vecinos::k_vecinos(const Registro_especies& r, int f, int k, vector<Candidato>& res) const {
+    priority_queue<Candidato> mejores;
+    if (raiz>=0) busca(r,raiz,r.consultar(f),f,k,mejores);
+    res.resize(mejores.size());
+    // Inv: res[i+1...] contiene los mejores candidatos ya extraídos, de menor a mayor
+    for (int i=res.size()-1; i>=0; --i) {
+        res[i]=mejores.top();
+        mejores.pop();
+    }
+}
+
+
+//Modificadoras
+
+int Indice_vecinos::construye(const Registro_especies& r, vector<int>& filas, int ini, int fin) {
+    int nodo=nodos.size();
+    nodos.push_back(Nodo());
+    Nodo x;
+    x.vp=-1;
+    x.mu=0;
+    x.radio=0;
+    x.dentro=x.fuera=-1;
+    x.norma_min=numeric_limits<double>::infinity();
+    x.norma_max=0;
+    for (int i=ini; i<fin; ++i) {
+        x.norma_min=min(x.norma_min,r.consultar(filas[i]).norma());
+        x.norma_max=max(x.norma_max,r.consultar(filas[i]).norma());
+    }
+
+    if (fin-ini>TAM_HOJA) {
+        // La referencia es la especie central del rango; el resto se reparte por la mediana del ángulo
+        swap(filas[ini],filas[ini+(fin-ini)/2]);
+        const Especie& p=r.consultar(filas[ini]);
+        vector<pair<double,int> > e;
+        double d;
+        for (int i=ini+1; i<fin; ++i) e.push_back(make_pair(angulo(p,r.consultar(filas[i]),d),filas[i]));
+        nth_element(e.begin(),e.begin()+e.size()/2,e.end());
+        double mu=e[e.size()/2].first;
+        int m=ini+1;
+        for (int i=0; i<e.size(); ++i) {
+            if (e[i].first<=mu) filas[m++]=e[i].second;
+            x.radio=max(x.radio,e[i].first);
+        }
+        int fin_dentro=m;
+        // Si todas quedan dentro (distancias iguales), el nodo se queda como hoja
+        if (m<fin) {
+            for (int i=0; i<e.size(); ++i) {
+                if (e[i].first>mu) filas[m++]=e[i].second;
+            }
+            x.vp=filas[ini];
+            x.mu=mu;
+            x.dentro=construye(r,filas,ini+1,fin_dentro);
+            x.fuera=construye(r,filas,fin_dentro,fin);
+        }
+    }
+    if (x.vp<0) x.hoja.assign(filas.begin()+ini,filas.begin()+fin);
+    nodos[nodo]=x;
+    return nodo;
+}
+
+void Indice_vecinos::construye(const Registro_especies& r) {
+    nodos.clear();
+    const vector<int>& orden=r.orden();
+    vector<int> filas(orden.begin(),orden.end());
+    raiz=filas.empty() ? -1 : construye(r,filas,0,filas.size());
+    valido=true;
+}
+
+void Indice_vecinos::invalida() {
+    valido=false;
+    nodos.clear();
+    raiz=-1;
+}
+
+void Indice_vecinos::inserta(const Registro_especies& r, int f) {
+    // Baja por el camino que seguiría la especie al construir, actualizando las cotas de los nodos
+    if (not valido) return;
+    const Especie& e=r.consultar(f);
+    if (raiz<0) {
+        vector<int> filas(1,f);
+        raiz=construye(r,filas,0,1);
+        return;
+    }
+    int p=raiz;
+    // Inv: la especie pertenece al subárbol de p, cuyos antecesores ya tienen las cotas actualizadas
+    double d;
+    while (nodos[p].vp>=0) {
+        Nodo& x=nodos[p];
+        x.norma_min=min(x.norma_min,e.norma());
+        x.norma_max=max(x.norma_max,e.norma());
+        double a=angulo(r.consultar(x.vp),e,d);
+        x.radio=max(x.radio,a);
+        bool dentro= a<=x.mu;
+        int hijo= dentro ? x.dentro : x.fuera;
+        if (hijo<0) {
+            // construye puede reubicar los nodos: x deja de ser válido
+            vector<int> filas(1,f);
+            hijo=construye(r,filas,0,1);
+            if (dentro) nodos[p].dentro=hijo;
+            else nodos[p].fuera=hijo;
+            return;
+        }
+        p=hijo;
+    }
+    nodos[p].norma_min=min(nodos[p].norma_min,e.norma());
+    nodos[p].norma_max=max(nodos[p].norma_max,e.norma());
+    nodos[p].hoja.push_back(f);
+    // Una hoja demasiado grande se reconstruye como subárbol
+    if (nodos[p].hoja.size()>2*TAM_HOJA) {
+        vector<int> filas=nodos[p].hoja;
+        int nuevo=construye(r,filas,0,filas.size());
+        nodos[p]=nodos[nuevo];
+        nodos[nuevo]=Nodo();
+        nodos[nuevo].vp=-1;
+    }
+}
+
+void Indice_vecinos::elimina(const Registro_especies& r, int f) {
+    // Baja por el camino de la especie; las cotas de los antecesores siguen siendo válidas
+    if (not valido) return;
+    const Especie& e=r.consultar(f);
+    int p=raiz;
+    double d;
+    // Inv: si la especie está en el p.i., está en el subárbol de p
+    while (p>=0) {
+        Nodo& x=nodos[p];
+        if (x.vp==f) {
+            invalida();
+            return;
+        }
+        if (x.vp<0) {
+            vector<int>::iterator it=find(x.hoja.begin(),x.hoja.end(),f);
+            if (it==x.hoja.end()) invalida();
+            else x.hoja.erase(it);
+            return;
+        }
+        p= angulo(r.consultar(x.vp),e,d)<=x.mu ? x.dentro : x.fuera;
+    }
+    invalida();
+}
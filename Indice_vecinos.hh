@@ -0,0 +1,169 @@
+/** @file Indice_vecinos.hh
+    @brief Especificación de la clase Indice_vecinos
+*/
+
+#ifndef INDICE_VECINOS_HH
+#define INDICE_VECINOS_HH
+
+#include "Registro_especies.hh"
+#ifndef NO_DIAGRAM
+#include <queue>
+#include <string>
+#include <vector>
+#endif
+
+
+/** @class Indice_vecinos
+    @brief Representa un índice (árbol de puntos de referencia, <em>vantage-point tree</em>) para buscar las especies
+    más cercanas a una especie.
+
+    La distancia entre especies no es una métrica (la de una especie consigo misma es 100), pero solo depende del
+    ángulo entre los perfiles y de la razón entre sus normas: si l = |x|/|q| y c = cos(ang(q,x)),
+    d(q,x) = (1 - sqrt((1 + l^2 - 2lc) / (1+l)^2)) * 100. El árbol se construye con el ángulo, que sí es una
+    métrica: cada nodo interno tiene una especie de referencia p y un radio mu, y las especies de su subárbol con
+    ángulo <= mu respecto a p van al hijo de dentro y el resto al de fuera. Cada nodo guarda además el máximo ángulo
+    de p con su subárbol y la mínima y máxima norma de sus especies; con la desigualdad triangular se acota el
+    ángulo de q con todo el subárbol y, con las normas, la distancia d desde abajo, de forma que la búsqueda
+    descarta los subárboles que no pueden mejorar los k vecinos ya encontrados.
+
+    El índice guarda filas de un Registro_especies, que se pasa a cada operación y no debe cambiar entre
+    operaciones sin avisar al índice. Las especies se añaden y se eliminan de forma incremental; eliminar la
+    especie de referencia de un nodo invalida el índice, que se reconstruye en la siguiente consulta.
+*/
+
+class Indice_vecinos {
+
+    private:
+        /** @brief Nodo del árbol */
+        struct Nodo {
+            /** @brief Fila de la especie de referencia, o -1 si es una hoja */
+            int vp;
+            /** @brief Ángulo que separa los hijos */
+            double mu;
+            /** @brief Máximo ángulo de vp con las especies del subárbol */
+            double radio;
+            /** @brief Mínima y máxima norma de las especies del subárbol (incluida vp) */
+            double norma_min, norma_max;
+            /** @brief Hijos de dentro (ángulo <= mu) y de fuera, o -1 */
+            int dentro, fuera;
+            /** @brief Filas de las especies de una hoja */
+            vector<int> hoja;
+        };
+
+        /** @brief Nodos del árbol */
+        vector<Nodo> nodos;
+
+        /** @brief Nodo raíz, o -1 si el árbol está vacío */
+        int raiz;
+
+        /** @brief Indica si el árbol contiene exactamente las especies del registro */
+        bool valido;
+
+        /** @brief Tamaño de una hoja al construir; una hoja se reconstruye al llegar al doble */
+        static const int TAM_HOJA=16;
+
+        /** @brief Candidato de la búsqueda: distancia e identificador (el mayor es el peor) */
+        typedef pair<double,string> Candidato;
+
+            /**
+            @brief Modificadora: Construye un subárbol.
+            \pre 0 <= ini <= fin <= filas.size(); las filas de [ini...fin-1] contienen especies de r.
+            \post Devuelve un nodo nuevo cuyo subárbol contiene las especies de las filas [ini...fin-1] (cuyo orden
+            se ha modificado).
+            */
+        int construye(const Registro_especies& r, vector<int>& filas, int ini, int fin);
+
+            /**
+            @brief Consultora: Busca en un subárbol.
+            \pre mejores contiene como mucho k candidatos.
+            \post Se han añadido a mejores los candidatos del subárbol de nodo que están entre los k mejores, sin
+            contar la fila fq.
+            */
+        void busca(const Registro_especies& r, int nodo, const Especie& q, int fq, int k,
+                   priority_queue<Candidato>& mejores) const;
+
+            /**
+            @brief Consultora: Cota inferior de la distancia a un subárbol.
+            \pre ang_max es una cota superior del ángulo de q con las especies del subárbol de nodo.
+            \post Devuelve una cota inferior de la distancia d de q (de norma nq) a las especies del subárbol.
+            */
+        double cota(int nodo, double nq, double ang_max) const;
+
+
+    public:
+
+    //Constructora
+
+            /**
+            @brief Constructora por defecto.
+            \pre <em>Cierto.</em>
+            \post Crea un índice vacío e inválido.
+            */
+        Indice_vecinos();
+
+
+    //Destructora
+
+            /**
+            @brief Destructora por defecto.
+            */
+        ~Indice_vecinos();
+
+
+    //Consultoras
+
+            /**
+            @brief Consultora: Indica si el índice es válido.
+            \pre <em>Cierto.</em>
+            \post Indica si el p.i. contiene exactamente las especies del registro.
+            */
+        bool es_valido() const;
+
+            /**
+            @brief Consultora: Memoria del índice.
+            \pre <em>Cierto.</em>
+            \post Devuelve los bytes que ocupan los nodos del p.i. y sus hojas.
+            */
+        size_t bytes() const;
+
+            /**
+            @brief Consultora: Busca los vecinos más cercanos de una especie.
+            \pre El p.i. es válido para r; la fila f contiene una especie; k > 0.
+            \post res contiene las min(k, n-1) especies de r (sin contar la de la fila f) con menor distancia a la
+            de la fila f, ordenadas por distancia y, si empatan, por identificador.
+            */
+        void k_vecinos(const Registro_especies& r, int f, int k, vector<Candidato>& res) const;
+
+
+    //Modificadoras
+
+            /**
+            @brief Modificadora: Construye el índice.
+            \pre <em>Cierto.</em>
+            \post El p.i. es válido y contiene todas las especies de r.
+            */
+        void construye(const Registro_especies& r);
+
+            /**
+            @brief Modificadora: Invalida el índice.
+            \pre <em>Cierto.</em>
+            \post El p.i. no es válido.
+            */
+        void invalida();
+
+            /**
+            @brief Modificadora: Añade una especie.
+            \pre La fila f de r contiene una especie que no está en el p.i.
+            \post Si el p.i. es válido, contiene la especie de la fila f.
+            */
+        void inserta(const Registro_especies& r, int f);
+
+            /**
+            @brief Modificadora: Elimina una especie.
+            \pre La fila f de r contiene una especie (que aún no se ha eliminado de r).
+            \post Si el p.i. es válido, ya no contiene la especie de la fila f, o ha dejado de ser válido.
+            */
+        void elimina(const Registro_especies& r, int f);
+};
+
+#endif
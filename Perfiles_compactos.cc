@@ -0,0 +1,450 @@
+/** @file Perfiles_compactos.cc
+    @brief Código de la clase Perfiles_compactos
+*/
+
+#include "Perfiles_compactos.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const int Perfiles_compactos::BASE;
+const int Perfiles_compactos::PANEL;
+const int Perfiles_compactos::BLOQUE_CODIGOS;
+const int Perfiles_compactos::MAX_CODIGOS_DENSA;
+const long long Perfiles_compactos::MAX_DENSA;
+
+/** @brief Cuatro double que se operan con una sola instrucción vectorial (o dos, según el procesador) */
+typedef double Vector4 __attribute__((vector_size(4*sizeof(double))));
+
+/**
+* Suma a c[r*4+s], para r y s en [0...3], el producto escalar de las columnas r de a y s de b, dos grupos de
+* nc códigos de la matriz densa. Los 16 productos se acumulan en registros: cada repetición de b se carga una
+* sola vez por código y se multiplica por las cuatro de a.
+*/
+static void nucleo_denso(const double* a, const double* b, int nc, double* c) {
+    Vector4 acc0={0,0,0,0}, acc1={0,0,0,0}, acc2={0,0,0,0}, acc3={0,0,0,0};
+    // Inv: acc_r[s] es el producto de las columnas r de a y s de b sobre los códigos anteriores a t
+    for (int t=0; t<nc; ++t) {
+        Vector4 vb;
+        memcpy(&vb,b+4*t,sizeof(vb));
+        acc0+=a[4*t]*vb;
+        acc1+=a[4*t+1]*vb;
+        acc2+=a[4*t+2]*vb;
+        acc3+=a[4*t+3]*vb;
+    }
+    for (int s=0; s<4; ++s) {
+        c[s]+=acc0[s];
+        c[4+s]+=acc1[s];
+        c[8+s]+=acc2[s];
+        c[12+s]+=acc3[s];
+    }
+}
+
+/**
+* Hash del substring de código c del diccionario d: el multiplicativo de su código empaquetado, o el FNV-1a de su
+* texto.
+*/
+static uint64_t hash_codigo(const Perfiles_compactos::Diccionario& d, int c) {
+    if (d.bits>0) return d.empaquetado[c]*0x9E3779B97F4A7C15ULL;
+    uint64_t h=14695981039346656037ULL;
+    for (int t=0; t<d.k; ++t) h=(h^(unsigned char)d.texto[size_t(c)*d.k+t])*1099511628211ULL;
+    return h;
+}
+
+/**
+* Pone el código c en la tabla de dispersión de d: en la primera posición libre desde la de su hash.
+*/
+static void coloca(Perfiles_compactos::Diccionario& d, int c) {
+    size_t m=d.tabla.size();
+    size_t h=(hash_codigo(d,c)>>32)&(m-1);
+    while (d.tabla[h]>=0) h=(h+1)&(m-1);
+    d.tabla[h]=c;
+}
+
+/**
+* Rehace la tabla de dispersión de d con m posiciones (una potencia de 2 mayor que el doble de los códigos).
+*/
+static void rehace(Perfiles_compactos::Diccionario& d, size_t m) {
+    d.tabla.assign(m,-1);
+    for (int c=0; c<d.num; ++c) coloca(d,c);
+}
+
+/**
+* Código del último substring añadido a d (el de código d.num) si ya estaba; si no, lo conserva con ese código.
+* La tabla tiene como mucho la mitad de las posiciones ocupadas (al llenarse más, dobla su tamaño); se busca de
+* forma lineal desde la posición del hash.
+*/
+static int busca_ultimo(Perfiles_compactos::Diccionario& d) {
+    int c=d.num;
+    if (2*(size_t(c)+1)>d.tabla.size()) rehace(d,max(size_t(16),2*d.tabla.size()));
+    size_t m=d.tabla.size();
+    size_t h=(hash_codigo(d,c)>>32)&(m-1);
+    const char* s=d.texto.data();
+    // Inv: las posiciones desde la del hash hasta h están ocupadas por otros substrings
+    while (d.tabla[h]>=0) {
+        int o=d.tabla[h];
+        bool igual= d.bits>0 ? d.empaquetado[o]==d.empaquetado[c] : memcmp(s+size_t(o)*d.k,s+size_t(c)*d.k,d.k)==0;
+        if (igual) return o;
+        h=(h+1)&(m-1);
+    }
+    d.tabla[h]=c;
+    return d.num++;
+}
+
+/** @brief Código del substring de código empaquetado e en el diccionario d, que busca por código empaquetado. */
+static int codigo_empaquetado(Perfiles_compactos::Diccionario& d, uint64_t e) {
+    d.empaquetado.resize(d.num);
+    d.empaquetado.push_back(e);
+    return busca_ultimo(d);
+}
+
+/** @brief Código del substring de k carácteres s en el diccionario d, que busca por texto. */
+static int codigo_texto(Perfiles_compactos::Diccionario& d, const char* s) {
+    d.texto.resize(size_t(d.num)*d.k);
+    d.texto.append(s,d.k);
+    return busca_ultimo(d);
+}
+
+/**
+* Pasa el diccionario d a buscar los substrings por su texto: los códigos empaquetados se traducen a texto y
+* conservan su código.
+*/
+static void pasa_a_texto(Perfiles_compactos::Diccionario& d) {
+    d.texto.clear();
+    d.texto.reserve(size_t(d.num)*d.k);
+    for (int c=0; c<d.num; ++c) d.texto+=Perfil::substring(d.empaquetado[c],d.bits,d.k);
+    vector<uint64_t>().swap(d.empaquetado);
+    d.bits=0;
+    rehace(d,d.tabla.size());
+}
+
+//Constructora y destructora
+
+Perfiles_compactos::Perfiles_compactos() {
+    ini.push_back(0);
+    num_codigos=0;
+}
+
+Perfiles_compactos::~Perfiles_compactos(){}
+
+
+//Consultoras
+
+int Perfiles_compactos::num_perfiles() const {
+    return norma2.size();
+}
+
+double Perfiles_compactos::producto(const Perfiles_compactos& q, int a, int b) const {
+    // Fusión de los dos vectores de códigos (con punteros: el recorrido es el bucle más interno del cálculo)
+    const int* ca=cod.data();
+    const int* ra=rep.data();
+    const int* cb=q.cod.data();
+    const int* rb=q.rep.data();
+    int pa=ini[a];
+    int fa=ini[a+1];
+    int pb=q.ini[b];
+    int fb=q.ini[b+1];
+    double s=0;
+    // Inv: s es el producto de los substrings comunes anteriores a pa y pb
+    while (pa<fa and pb<fb) {
+        if (ca[pa]==cb[pb]) {
+            s+=double(ra[pa])*rb[pb];
+            ++pa;
+            ++pb;
+        }
+        else if (ca[pa]<cb[pb]) ++pa;
+        else ++pb;
+    }
+    return s;
+}
+
+double Perfiles_compactos::producto(int a, int b) const {
+    return producto(*this,a,b);
+}
+
+double Perfiles_compactos::distancia_producto(const Perfiles_compactos& q, int a, int b, double s) const {
+    // |a-b|^2 = |a|^2 + |b|^2 - 2 a·b, con las mismas operaciones finales que Especie::distancia
+    double top=sqrt(norma2[a]+q.norma2[b]-2*s);
+    double v=sqrt(norma2[a]);
+    double w=sqrt(q.norma2[b]);
+    double res=v+w;
+    return ((1-(top/res))*100);
+}
+
+double Perfiles_compactos::distancia_producto(int a, int b, double s) const {
+    return distancia_producto(*this,a,b,s);
+}
+
+double Perfiles_compactos::distancia(int a, int b) const {
+    return distancia_producto(a,b,producto(a,b));
+}
+
+void Perfiles_compactos::distancias(const Perfiles_compactos& q, int i_ini, int i_fin, int j_ini, int j_fin,
+                                   bool triangular, const function<void(int,int,double)>& f) const {
+    // Se descartan los rectángulos sin ningún par (con i < j, si triangular)
+    if (i_ini>=i_fin or j_ini>=j_fin or (triangular and j_fin-1<=i_ini)) return;
+    if ((long long)(i_fin-i_ini)*(j_fin-j_ini)<=BASE) {
+        // Inv: se han calculado los pares de las filas anteriores a i
+        for (int i=i_ini; i<i_fin; ++i) {
+            for (int j= triangular ? max(j_ini,i+1) : j_ini; j<j_fin; ++j) {
+                f(i,j,distancia_producto(q,i,j,producto(q,i,j)));
+            }
+        }
+        return;
+    }
+    if (i_fin-i_ini>=j_fin-j_ini) {
+        int m=(i_ini+i_fin)/2;
+        distancias(q,i_ini,m,j_ini,j_fin,triangular,f);
+        distancias(q,m,i_fin,j_ini,j_fin,triangular,f);
+    }
+    else {
+        int m=(j_ini+j_fin)/2;
+        distancias(q,i_ini,i_fin,j_ini,m,triangular,f);
+        distancias(q,i_ini,i_fin,m,j_fin,triangular,f);
+    }
+}
+
+void Perfiles_compactos::distancias(int i_ini, int i_fin, int j_ini, int j_fin,
+                                   const function<void(int,int,double)>& f) const {
+    distancias(*this,i_ini,i_fin,j_ini,j_fin,true,f);
+}
+
+void Perfiles_compactos::distancias(const Perfiles_compactos& q, const function<void(int,int,double)>& f) const {
+    distancias(q,0,num_perfiles(),0,q.num_perfiles(),false,f);
+}
+
+void Perfiles_compactos::distancias_indice(int i_ini, int i_fin, const function<void(int,int,double)>& f) const {
+    int n=num_perfiles();
+    vector<double> s(n,0);
+    const int* p=ind_perfil.data();
+    const int* r=ind_rep.data();
+    const int* ii=ini_ind.data();
+    // Inv: se han calculado los pares de las filas anteriores a i
+    for (int i=i_ini; i<i_fin; ++i) {
+        // Inv: s[j] es el producto de i y j (j > i) sobre los substrings de i anteriores a t
+        for (int t=ini[i]; t<ini[i+1]; ++t) {
+            int c=cod[t];
+            // Las apariciones están ordenadas por perfil: se salta directamente a las posteriores a i
+            const int* q=upper_bound(p+ii[c],p+ii[c+1],i);
+            for (; q<p+ii[c+1]; ++q) s[*q]+=double(rep[t])*r[q-p];
+        }
+        for (int j=i+1; j<n; ++j) {
+            f(i,j,distancia_producto(i,j,s[j]));
+            s[j]=0;
+        }
+    }
+}
+
+void Perfiles_compactos::distancias_indice(const Perfiles_compactos& q,
+                                          const function<void(int,int,double)>& f) const {
+    int n=q.num_perfiles();
+    vector<double> s(n,0);
+    const int* p=q.ind_perfil.data();
+    const int* r=q.ind_rep.data();
+    const int* ii=q.ini_ind.data();
+    // Inv: se han calculado los pares de las filas anteriores a i
+    for (int i=0; i<num_perfiles(); ++i) {
+        // Los códigos de i están ordenados: a partir del primero que se ha añadido al diccionario después de
+        // construir q, ninguno aparece en q
+        // Inv: s[j] es el producto de i y j sobre los substrings de i anteriores a t
+        for (int t=ini[i]; t<ini[i+1] and cod[t]<q.num_codigos; ++t) {
+            int c=cod[t];
+            for (int x=ii[c]; x<ii[c+1]; ++x) s[p[x]]+=double(rep[t])*r[x];
+        }
+        for (int j=0; j<n; ++j) {
+            f(i,j,distancia_producto(q,i,j,s[j]));
+            s[j]=0;
+        }
+    }
+}
+
+void Perfiles_compactos::distancias_densa(int i_ini, int i_fin, const function<void(int,int,double)>& f) const {
+    int n=num_perfiles();
+    if (densa.empty()) {
+        distancias(i_ini,i_fin,i_ini+1,n,f);
+        return;
+    }
+    if (i_ini>=i_fin) return;
+    static_assert(PANEL==4,"nucleo_denso multiplica grupos de 4 perfiles");
+    int grupos=(n+PANEL-1)/PANEL;
+    int g_ini=i_ini/PANEL;
+    int g_fin=(i_fin-1)/PANEL+1;
+    // El bloque de los grupos gi y gj (gi <= gj) está en prod[((gi-g_ini)*grupos+gj)*PANEL*PANEL]
+    vector<double> prod(size_t(g_fin-g_ini)*grupos*PANEL*PANEL,0);
+    const double* d=densa.data();
+    double* pr=prod.data();
+    // Inv: prod contiene los productos sobre los códigos anteriores a c
+    for (int c=0; c<num_codigos; c+=BLOQUE_CODIGOS) {
+        int nc=min(BLOQUE_CODIGOS,num_codigos-c);
+        for (int gi=g_ini; gi<g_fin; ++gi) {
+            const double* a=d+(size_t(gi)*num_codigos+c)*PANEL;
+            for (int gj=gi; gj<grupos; ++gj) {
+                nucleo_denso(a,d+(size_t(gj)*num_codigos+c)*PANEL,nc,pr+(size_t(gi-g_ini)*grupos+gj)*PANEL*PANEL);
+            }
+        }
+    }
+    // Inv: se han calculado los pares de las filas anteriores a i
+    for (int i=i_ini; i<i_fin; ++i) {
+        const double* fila=pr+size_t(i/PANEL-g_ini)*grupos*PANEL*PANEL+i%PANEL*PANEL;
+        for (int j=i+1; j<n; ++j) f(i,j,distancia_producto(i,j,fila[j/PANEL*PANEL*PANEL+j%PANEL]));
+    }
+}
+
+void Perfiles_compactos::distancias_densa(const Perfiles_compactos& q,
+                                         const function<void(int,int,double)>& f) const {
+    if (densa.empty() or q.densa.empty()) {
+        distancias(q,f);
+        return;
+    }
+    int n=num_perfiles();
+    int m=q.num_perfiles();
+    int gp=(n+PANEL-1)/PANEL;
+    int gq=(m+PANEL-1)/PANEL;
+    // Los códigos que solo tiene uno de los dos conjuntos no suman nada al producto
+    int nc_comun=min(num_codigos,q.num_codigos);
+    // El bloque de los grupos gi del p.i. y gj de q está en prod[(gi*gq+gj)*PANEL*PANEL]
+    vector<double> prod(size_t(gp)*gq*PANEL*PANEL,0);
+    double* pr=prod.data();
+    // Inv: prod contiene los productos sobre los códigos anteriores a c
+    for (int c=0; c<nc_comun; c+=BLOQUE_CODIGOS) {
+        int nc=min(BLOQUE_CODIGOS,nc_comun-c);
+        for (int gi=0; gi<gp; ++gi) {
+            const double* a=densa.data()+(size_t(gi)*num_codigos+c)*PANEL;
+            for (int gj=0; gj<gq; ++gj) {
+                nucleo_denso(a,q.densa.data()+(size_t(gj)*q.num_codigos+c)*PANEL,nc,pr+(size_t(gi)*gq+gj)*PANEL*PANEL);
+            }
+        }
+    }
+    // Inv: se han calculado los pares de las filas anteriores a i
+    for (int i=0; i<n; ++i) {
+        const double* fila=pr+size_t(i/PANEL)*gq*PANEL*PANEL+i%PANEL*PANEL;
+        for (int j=0; j<m; ++j) f(i,j,distancia_producto(q,i,j,fila[j/PANEL*PANEL*PANEL+j%PANEL]));
+    }
+}
+
+
+//Modificadoras
+
+void Perfiles_compactos::construye(const vector<const Perfil*>& p) {
+    Diccionario codigo;
+    construye(p,codigo);
+}
+
+void Perfiles_compactos::construye(const vector<const Perfil*>& p, Diccionario& codigo) {
+    ini.assign(1,0);
+    cod.clear();
+    rep.clear();
+    ini_ind.clear();
+    ind_perfil.clear();
+    ind_rep.clear();
+    densa.clear();
+    norma2.assign(p.size(),0);
+    vector<pair<int,int> > aux;
+    // Inv: se han copiado los perfiles anteriores a i
+    for (int i=0; i<p.size(); ++i) {
+        const Perfil& q=*p[i];
+        aux.clear();
+        if (q.bits!=0 and (codigo.bits<0 or (codigo.bits==q.bits and codigo.k==q.k))) {
+            codigo.bits=q.bits;
+            codigo.k=q.k;
+            for (int t=0; t<q.cod.size(); ++t) aux.push_back(make_pair(codigo_empaquetado(codigo,q.cod[t]),q.rep[t]));
+        }
+        else {
+            if (codigo.bits>0) pasa_a_texto(codigo);
+            codigo.bits=0;
+            codigo.k=q.k;
+            for (int t=0; t<q.cod.size(); ++t) {
+                string s=Perfil::substring(q.cod[t],q.bits,q.k);
+                aux.push_back(make_pair(codigo_texto(codigo,s.data()),q.rep[t]));
+            }
+            for (map<string,int>::const_iterator it=q.texto.begin(); it!=q.texto.end(); ++it) {
+                aux.push_back(make_pair(codigo_texto(codigo,(*it).first.data()),(*it).second));
+            }
+        }
+        for (int t=0; t<aux.size(); ++t) norma2[i]+=double(aux[t].second)*aux[t].second;
+        sort(aux.data(),aux.data()+aux.size());
+        for (int t=0; t<aux.size(); ++t) {
+            cod.push_back(aux[t].first);
+            rep.push_back(aux[t].second);
+        }
+        ini.push_back(cod.size());
+    }
+    num_codigos=codigo.num;
+}
+
+void Perfiles_compactos::indexa() {
+    // Ordenación por cubetas: se cuentan las apariciones de cada código y se reparten los perfiles en orden
+    ini_ind.assign(num_codigos+1,0);
+    for (int t=0; t<cod.size(); ++t) ++ini_ind[cod[t]+1];
+    for (int c=0; c<num_codigos; ++c) ini_ind[c+1]+=ini_ind[c];
+    ind_perfil.resize(cod.size());
+    ind_rep.resize(cod.size());
+    vector<int> sig(ini_ind.begin(),ini_ind.end()-1);
+    // Inv: se han añadido al índice los substrings de los perfiles anteriores a i
+    for (int i=0; i<num_perfiles(); ++i) {
+        for (int t=ini[i]; t<ini[i+1]; ++t) {
+            ind_perfil[sig[cod[t]]]=i;
+            ind_rep[sig[cod[t]]++]=rep[t];
+        }
+    }
+}
+
+size_t Perfiles_compactos::bytes() const {
+    return (ini.capacity()+cod.capacity()+rep.capacity()+ini_ind.capacity()+ind_perfil.capacity()+
+            ind_rep.capacity())*sizeof(int)+(norma2.capacity()+densa.capacity())*sizeof(double);
+}
+
+size_t Perfiles_compactos::bytes_densa() const {
+    return size_t((num_perfiles()+PANEL-1)/PANEL)*PANEL*num_codigos*sizeof(double);
+}
+
+size_t Perfiles_compactos::max_bytes_densa() {
+    return size_t(MAX_DENSA)*sizeof(double);
+}
+
+bool Perfiles_compactos::densifica(size_t max_bytes) {
+    int n=num_perfiles();
+    long long elementos=(long long)(n+PANEL-1)/PANEL*PANEL*num_codigos;
+    if (num_codigos>MAX_CODIGOS_DENSA or elementos>MAX_DENSA or bytes_densa()>max_bytes) {
+        vector<double>().swap(densa);
+        return false;
+    }
+    densa.assign(elementos,0);
+    // Inv: se han copiado a la matriz los perfiles anteriores a i
+    for (int i=0; i<n; ++i) {
+        for (int t=ini[i]; t<ini[i+1]; ++t) densa[(size_t(i/PANEL)*num_codigos+cod[t])*PANEL+i%PANEL]=rep[t];
+    }
+    return true;
+}
+
+void Perfiles_compactos::remuestrea(const Perfiles_compactos& base, mt19937_64& gen) {
+    int n=base.num_perfiles();
+    ini.assign(1,0);
+    cod.clear();
+    rep.clear();
+    ini_ind.clear();
+    ind_perfil.clear();
+    ind_rep.clear();
+    densa.clear();
+    norma2.assign(n,0);
+    num_codigos=base.num_codigos;
+    // Inv: se han remuestreado los perfiles anteriores a i
+    for (int i=0; i<n; ++i) {
+        long long total=0;
+        for (int t=base.ini[i]; t<base.ini[i+1]; ++t) total+=base.rep[t];
+        // Inv: quedan por repartir total extracciones entre los substrings a partir de t, que suman resto
+        long long quedan=total, resto=total;
+        for (int t=base.ini[i]; t<base.ini[i+1] and quedan>0; ++t) {
+            long long r=quedan;
+            if (base.rep[t]<resto) r=binomial_distribution<long long>(quedan,double(base.rep[t])/resto)(gen);
+            resto-=base.rep[t];
+            if (r>0) {
+                cod.push_back(base.cod[t]);
+                rep.push_back(r);
+                norma2[i]+=double(r)*r;
+                quedan-=r;
+            }
+        }
+        ini.push_back(cod.size());
+    }
+}
@@ -0,0 +1,309 @@
+/** @file Perfiles_compactos.hh
+    @brief Especificación de la clase Perfiles_compactos
+*/
+
+#ifndef PERFILES_COMPACTOS_HH
+#define PERFILES_COMPACTOS_HH
+#include "Especie.hh"
+#ifndef NO_DIAGRAM
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#endif
+using namespace std;
+
+
+/** @class Perfiles_compactos
+    @brief Representa una copia compacta de los perfiles (substrings con sus repeticiones) de un conjunto de especies,
+    pensada para calcular las distancias entre todos los pares.
+
+    Cada substring diferente se sustituye por un código entero consecutivo (ver Diccionario), y los perfiles se guardan uno detrás de otro como
+    vectores de pares (código, repeticiones) ordenados por código, junto con el cuadrado de su norma. La distancia
+    entre dos perfiles se obtiene del producto escalar: todas las sumas son enteras (exactas en <em>double</em>), así
+    que el resultado es idéntico al de Especie::distancia.
+
+    El cálculo de todos los pares divide recursivamente el rectángulo de pares por la mitad de su lado más largo
+    hasta llegar a bloques pequeños: los perfiles de cada bloque se visitan una sola vez por bloque en cualquier
+    nivel de la jerarquía de memoria, sin depender de su tamaño (<em>cache-oblivious</em>).
+
+    Opcionalmente se construye un índice invertido (para cada substring, los perfiles que lo contienen), con el que
+    los productos escalares de un perfil con todos los demás se acumulan recorriendo solo los substrings comunes.
+    Es la mejor opción cuando los perfiles comparten pocos substrings (genes cortos y k grande).
+
+    Cuando hay pocos substrings diferentes (k pequeño), los perfiles también se pueden guardar como una matriz densa
+    de repeticiones, una fila por perfil y una columna por substring. Los productos escalares de todos los pares son
+    entonces el producto de la matriz por su traspuesta, que se calcula por bloques de PANEL x PANEL pares con
+    instrucciones vectoriales, como en una multiplicación de matrices (GEMM).
+*/
+
+class Perfiles_compactos {
+
+    private:
+        /** @brief El perfil p ocupa las posiciones [ini[p]...ini[p+1]-1] de cod y rep */
+        vector<int> ini;
+
+        /** @brief Código de cada substring, de menor a mayor dentro de cada perfil */
+        vector<int> cod;
+
+        /** @brief Repeticiones de cada substring */
+        vector<int> rep;
+
+        /** @brief Cuadrado de la norma de cada perfil */
+        vector<double> norma2;
+
+        /** @brief Número de substrings diferentes */
+        int num_codigos;
+
+        /** @brief Índice invertido (vacío si no se ha construido): los perfiles que contienen el substring de 
+        código c ocupan las posiciones [ini_ind[c]...ini_ind[c+1]-1] de ind_perfil e ind_rep, de menor a mayor perfil */
+        vector<int> ini_ind;
+
+        /** @brief Perfil y repeticiones de cada aparición de un substring en el índice invertido */
+        vector<int> ind_perfil, ind_rep;
+
+        /** @brief Matriz densa (vacía si no se ha construido). Los perfiles se agrupan de PANEL en PANEL, y las
+        repeticiones del substring de código c en el perfil g*PANEL+r están en densa[(g*num_codigos+c)*PANEL+r]
+        (cero para los perfiles que completan el último grupo) */
+        vector<double> densa;
+
+        /** @brief Número máximo de pares de un bloque que ya no se divide */
+        static const int BASE=64;
+
+        /** @brief Perfiles de cada grupo de la matriz densa */
+        static const int PANEL=4;
+
+        /** @brief Códigos que se recorren seguidos en la matriz densa, para que los grupos de una fila de
+        bloques se queden en la caché mientras se multiplican por todos los demás */
+        static const int BLOQUE_CODIGOS=256;
+
+        /** @brief Número máximo de substrings diferentes y de elementos de la matriz densa */
+        static const int MAX_CODIGOS_DENSA=1<<16;
+        static const long long MAX_DENSA=1LL<<25;
+
+
+            /**
+            @brief Consultora: Distancia entre dos perfiles a partir de su producto escalar.
+            \pre 0 <= a, b < num_perfiles(); s = producto(a, b).
+            \post Devuelve distancia(a, b).
+            */
+        double distancia_producto(int a, int b, double s) const;
+
+            /**
+            @brief Consultora: Producto escalar de un perfil del p.i. y uno de q.
+            \pre 0 <= a < num_perfiles(); 0 <= b < q.num_perfiles(); los códigos de q son los del p.i.
+            \post Devuelve la suma, para los substrings comunes, del producto de sus repeticiones.
+            */
+        double producto(const Perfiles_compactos& q, int a, int b) const;
+
+            /**
+            @brief Consultora: Distancia entre un perfil del p.i. y uno de q a partir de su producto escalar.
+            \pre 0 <= a < num_perfiles(); 0 <= b < q.num_perfiles(); s = producto(q, a, b).
+            \post Devuelve la distancia entre el perfil a del p.i. y el perfil b de q.
+            */
+        double distancia_producto(const Perfiles_compactos& q, int a, int b, double s) const;
+
+            /**
+            @brief Consultora: Distancias de un rectángulo de pares entre el p.i. y q.
+            \pre 0 <= i_ini, i_fin <= num_perfiles(); 0 <= j_ini, j_fin <= q.num_perfiles(); los códigos de q son
+            los del p.i.
+            \post Se ha llamado a f(i, j, d) una vez para cada par con i en [i_ini...i_fin-1], j en [j_ini...j_fin-1]
+            (e i < j si triangular), donde d es la distancia entre el perfil i del p.i. y el perfil j de q. El
+            rectángulo se divide por la mitad de su lado más largo hasta que tiene como mucho BASE pares.
+            */
+        void distancias(const Perfiles_compactos& q, int i_ini, int i_fin, int j_ini, int j_fin, bool triangular,
+                        const function<void(int,int,double)>& f) const;
+
+
+    public:
+
+        /** @brief Diccionario de los códigos de los substrings, que pueden compartir varios conjuntos (ver
+            construye). Los substrings se buscan en una tabla de dispersión abierta y se guardan uno detrás de otro,
+            en el orden de sus códigos: mientras todos los perfiles tienen los mismos bits por carácter, como códigos
+            empaquetados; desde el primer perfil con otros bits o de texto, como texto (todos tienen k carácteres).
+            Solo se reserva memoria cuando un vector dobla su tamaño, no por cada substring. */
+        struct Diccionario {
+            /** @brief Bits por carácter de los códigos empaquetados (-1 si aún no hay ninguno; 0 si se busca por texto) */
+            int bits;
+            /** @brief Número de carácteres de los substrings */
+            int k;
+            /** @brief Tabla de dispersión: código de cada posición ocupada (-1 en las libres) */
+            vector<int> tabla;
+            /** @brief Código empaquetado del substring de cada código, si bits > 0 */
+            vector<uint64_t> empaquetado;
+            /** @brief Texto del substring de código c en [c*k...c*k+k-1], si bits es 0 */
+            string texto;
+            /** @brief Número de códigos */
+            int num;
+
+            Diccionario() : bits(-1), k(0), num(0) {}
+        };
+
+    //Constructora
+
+            /**
+            @brief Constructora por defecto.
+            \pre <em>Cierto.</em>
+            \post Crea un conjunto sin perfiles.
+            */
+        Perfiles_compactos();
+
+
+    //Destructora
+
+            /**
+            @brief Destructora por defecto.
+            */
+        ~Perfiles_compactos();
+
+
+    //Consultoras
+
+            /**
+            @brief Consultora: Devuelve el número de perfiles.
+            \pre <em>Cierto.</em>
+            \post Devuelve el número de perfiles del p.i.
+            */
+        int num_perfiles() const;
+
+            /**
+            @brief Consultora: Memoria de los perfiles compactos.
+            \pre <em>Cierto.</em>
+            \post Devuelve los bytes que ocupan los vectores del p.i., con el índice invertido y la matriz densa si
+            se han construido.
+            */
+        size_t bytes() const;
+
+            /**
+            @brief Consultora: Memoria de la matriz densa.
+            \pre <em>Cierto.</em>
+            \post Devuelve los bytes que ocuparía la matriz densa de los perfiles del p.i.
+            */
+        size_t bytes_densa() const;
+
+            /**
+            @brief Consultora: Memoria máxima de una matriz densa.
+            \pre <em>Cierto.</em>
+            \post Devuelve los bytes de una matriz densa de MAX_DENSA elementos.
+            */
+        static size_t max_bytes_densa();
+
+            /**
+            @brief Consultora: Producto escalar de dos perfiles.
+            \pre 0 <= a, b < num_perfiles().
+            \post Devuelve la suma, para los substrings comunes de a y b, del producto de sus repeticiones.
+            */
+        double producto(int a, int b) const;
+
+            /**
+            @brief Consultora: Distancia entre dos perfiles.
+            \pre 0 <= a, b < num_perfiles().
+            \post Devuelve la distancia entre los perfiles a y b, idéntica a la de Especie::distancia.
+            */
+        double distancia(int a, int b) const;
+
+            /**
+            @brief Consultora: Distancias de un rectángulo de pares.
+            \pre 0 <= i_ini, i_fin, j_ini, j_fin <= num_perfiles().
+            \post Se ha llamado a f(i, j, distancia(i, j)) una vez para cada par con i en [i_ini...i_fin-1],
+            j en [j_ini...j_fin-1] e i < j.
+            */
+        void distancias(int i_ini, int i_fin, int j_ini, int j_fin, const function<void(int,int,double)>& f) const;
+
+            /**
+            @brief Consultora: Distancias entre todos los perfiles del p.i. y todos los de otro conjunto.
+            \pre Los perfiles de q se han construido con el mismo diccionario de códigos que los del p.i.
+            \post Se ha llamado a f(i, j, d) una vez para cada perfil i del p.i. y cada perfil j de q, donde d es
+            la distancia entre los dos perfiles, idéntica a la de Especie::distancia.
+            */
+        void distancias(const Perfiles_compactos& q, const function<void(int,int,double)>& f) const;
+
+            /**
+            @brief Consultora: Distancias de unas filas con el índice invertido.
+            \pre Se ha construido el índice invertido; 0 <= i_ini <= i_fin <= num_perfiles().
+            \post Se ha llamado a f(i, j, distancia(i, j)) una vez para cada par con i en [i_ini...i_fin-1] e i < j.
+            Los productos de cada fila i se acumulan recorriendo, para cada substring de i, los perfiles posteriores
+            que también lo contienen; los pares sin substrings comunes no cuestan ningún recorrido.
+            */
+        void distancias_indice(int i_ini, int i_fin, const function<void(int,int,double)>& f) const;
+
+            /**
+            @brief Consultora: Distancias entre todos los perfiles del p.i. y todos los de otro conjunto con su índice
+            invertido.
+            \pre Los perfiles de q se han construido con el mismo diccionario de códigos que los del p.i. y q tiene el
+            índice invertido.
+            \post Igual que distancias(q, f), pero los productos de cada perfil i del p.i. se acumulan recorriendo, para
+            cada substring de i, los perfiles de q que también lo contienen.
+            */
+        void distancias_indice(const Perfiles_compactos& q, const function<void(int,int,double)>& f) const;
+
+            /**
+            @brief Consultora: Distancias de unas filas con la matriz densa.
+            \pre 0 <= i_ini <= i_fin <= num_perfiles().
+            \post Se ha llamado a f(i, j, distancia(i, j)) una vez para cada par con i en [i_ini...i_fin-1] e i < j.
+            Si se ha construido la matriz densa, los productos se calculan bloque a bloque sobre ella; si no, equivale
+            a distancias(i_ini, i_fin, i_ini+1, num_perfiles(), f).
+            */
+        void distancias_densa(int i_ini, int i_fin, const function<void(int,int,double)>& f) const;
+
+            /**
+            @brief Consultora: Distancias entre todos los perfiles del p.i. y todos los de otro conjunto con sus
+            matrices densas.
+            \pre Los perfiles de q se han construido con el mismo diccionario de códigos que los del p.i.
+            \post Igual que distancias(q, f). Si el p.i. y q tienen la matriz densa, los productos se calculan bloque a
+            bloque sobre las dos matrices (hasta el último código que tienen las dos); si no, se usa la fusión.
+            */
+        void distancias_densa(const Perfiles_compactos& q, const function<void(int,int,double)>& f) const;
+
+
+    //Modificadoras
+
+            /**
+            @brief Modificadora: Construye los perfiles compactos.
+            \pre <em>Cierto.</em>
+            \post El perfil i del p.i. es una copia compacta de *p[i]. El p.i. no tiene índice invertido ni matriz
+            densa.
+            */
+        void construye(const vector<const Perfil*>& p);
+
+            /**
+            @brief Modificadora: Construye los perfiles compactos con un diccionario de códigos compartido.
+            \pre Los perfiles de p y los que se han dado antes a codigo tienen el mismo k.
+            \post Igual que construye(p), pero los substrings que están en codigo conservan su código y los nuevos se
+            añaden a codigo con los siguientes. Los conjuntos construidos con el mismo diccionario se pueden
+            comparar entre sí (distancias(q, f)), así que los perfiles se pueden compactar por bloques a medida
+            que llegan.
+            */
+        void construye(const vector<const Perfil*>& p, Diccionario& codigo);
+
+            /**
+            @brief Modificadora: Construye el índice invertido.
+            \pre <em>Cierto.</em>
+            \post El p.i. tiene, para cada substring, la lista de perfiles que lo contienen con sus repeticiones.
+            */
+        void indexa();
+
+            /**
+            @brief Modificadora: Construye la matriz densa.
+            \pre <em>Cierto.</em>
+            \post Si hay como mucho MAX_CODIGOS_DENSA substrings diferentes, la matriz tiene como mucho MAX_DENSA
+            elementos y ocupa como mucho max_bytes bytes (bytes_densa), el p.i. tiene la matriz densa de repeticiones
+            y devuelve cierto; si no, no la tiene (distancias_densa usa la fusión) y devuelve falso.
+            */
+        bool densifica(size_t max_bytes);
+
+            /**
+            @brief Modificadora: Remuestrea los perfiles de otro conjunto (<em>bootstrap</em>).
+            \pre <em>Cierto.</em>
+            \post Cada perfil del p.i. tiene tantos substrings (contando las repeticiones) como el mismo perfil de
+            base, escogidos al azar con reposición entre los de base con probabilidad proporcional a sus repeticiones
+            (una multinomial, que se obtiene con una binomial por substring). Los substrings que no salen se quitan.
+            Los códigos son los de base; el p.i. no tiene índice invertido ni matriz densa. Los vectores del p.i. se
+            reutilizan, así que remuestrear varias veces sobre el mismo objeto no reserva memoria.
+            */
+        void remuestrea(const Perfiles_compactos& base, mt19937_64& gen);
+};
+
+#endif
@@ -0,0 +1,224 @@
+/** @file Pool_tareas.cc
+    @brief Código de la clase Pool_tareas
+*/
+
+#include "Pool_tareas.hh"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+
+thread_local Pool_tareas* Pool_tareas::pool_actual=0;
+thread_local int Pool_tareas::hilo_actual=-1;
+
+static long long nanosegundos(chrono::steady_clock::duration t) {
+    return chrono::duration_cast<chrono::nanoseconds>(t).count();
+}
+
+//Constructora y destructora
+
+Pool_tareas::Pool_tareas(int n, bool fijar) {
+    en_cola=0;
+    pendientes=0;
+    fin=false;
+    turno=0;
+    inicio=chrono::steady_clock::now();
+    if (n<1) n=1;
+    vector<int> cpus;
+    if (fijar) cpus=procesadores();
+    for (int i=0; i<n; ++i) {
+        trab.push_back(unique_ptr<Trabajador>(new Trabajador()));
+        trab[i]->cpu= cpus.empty() ? -1 : cpus[i%cpus.size()];
+        trab[i]->tareas=0;
+        trab[i]->robadas=0;
+        trab[i]->ocupado=0;
+    }
+    for (int i=0; i<n; ++i) {
+        hilos.push_back(thread(&Pool_tareas::trabaja,this,i));
+        if (trab[i]->cpu>=0) {
+            cpu_set_t c;
+            CPU_ZERO(&c);
+            CPU_SET(trab[i]->cpu,&c);
+            if (pthread_setaffinity_np(hilos[i].native_handle(),sizeof(c),&c)!=0) trab[i]->cpu=-1;
+        }
+    }
+}
+
+Pool_tareas::~Pool_tareas() {
+    espera();
+    {
+        unique_lock<mutex> l(m);
+        fin=true;
+    }
+    hay_tarea.notify_all();
+    for (int i=0; i<hilos.size(); ++i) hilos[i].join();
+}
+
+
+//Consultoras
+
+int Pool_tareas::num_hilos() const {
+    return hilos.size();
+}
+
+vector<int> Pool_tareas::procesadores() {
+    // Procesadores permitidos, nodo a nodo según /sys/devices/system/node/nodeX/cpulist ("0-3,8-11")
+    cpu_set_t permitidos;
+    CPU_ZERO(&permitidos);
+    if (sched_getaffinity(0,sizeof(permitidos),&permitidos)!=0) return vector<int>();
+    vector<int> res;
+    vector<char> visto(CPU_SETSIZE,false);
+    // Inv: res contiene los procesadores permitidos de los nodos anteriores a nodo
+    for (int nodo=0; ; ++nodo) {
+        ifstream f("/sys/devices/system/node/node"+to_string(nodo)+"/cpulist");
+        string lista;
+        if (not (f>>lista)) break;
+        istringstream s(lista);
+        string rango;
+        while (getline(s,rango,',')) {
+            int a,b;
+            size_t guion=rango.find('-');
+            a=atoi(rango.c_str());
+            b= guion==string::npos ? a : atoi(rango.c_str()+guion+1);
+            for (int c=a; c<=b and c<CPU_SETSIZE; ++c) {
+                if (c>=0 and CPU_ISSET(c,&permitidos) and not visto[c]) {
+                    visto[c]=true;
+                    res.push_back(c);
+                }
+            }
+        }
+    }
+    // Los procesadores que no aparecen en ningún nodo (o todos, si no se conocen los nodos) van al final
+    for (int c=0; c<CPU_SETSIZE; ++c) {
+        if (CPU_ISSET(c,&permitidos) and not visto[c]) res.push_back(c);
+    }
+    return res;
+}
+
+
+//Modificadoras
+
+bool Pool_tareas::coge(int w, function<void()>& f, bool& robada) {
+    int n=trab.size();
+    // Inv: las colas de los hilos w, w+1, ... anteriores a w+i (módulo n) estaban vacías al mirarlas
+    for (int i=0; i<n; ++i) {
+        Trabajador& t=*trab[(w+i)%n];
+        unique_lock<mutex> l(t.m);
+        if (not t.cola.empty()) {
+            if (i==0) {
+                f=move(t.cola.back());
+                t.cola.pop_back();
+            }
+            else {
+                f=move(t.cola.front());
+                t.cola.pop_front();
+            }
+            l.unlock();
+            robada= i>0;
+            unique_lock<mutex> lc(m);
+            --en_cola;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Pool_tareas::trabaja(int w) {
+    pool_actual=this;
+    hilo_actual=w;
+    Trabajador& t=*trab[w];
+    // Inv: las tareas que ha cogido este hilo se han ejecutado
+    while (true) {
+        function<void()> f;
+        bool robada;
+        if (not coge(w,f,robada)) {
+            unique_lock<mutex> l(m);
+            hay_tarea.wait(l,[this]() { return fin or en_cola>0; });
+            if (fin and en_cola==0) return;
+            continue;
+        }
+        chrono::steady_clock::time_point t0=chrono::steady_clock::now();
+        f();
+        t.ocupado+=nanosegundos(chrono::steady_clock::now()-t0);
+        ++t.tareas;
+        if (robada) ++t.robadas;
+        unique_lock<mutex> l(m);
+        --pendientes;
+        if (pendientes==0) sin_tareas.notify_all();
+    }
+}
+
+void Pool_tareas::envia(function<void()> f) {
+    // La tarea cuenta como pendiente antes de ponerla en la cola, para que espera() no pueda acabar
+    // entre que otro hilo la coge y la ejecuta
+    int w= pool_actual==this ? hilo_actual : turno++%trab.size();
+    {
+        unique_lock<mutex> l(m);
+        ++pendientes;
+    }
+    {
+        unique_lock<mutex> l(trab[w]->m);
+        trab[w]->cola.push_back(move(f));
+    }
+    {
+        unique_lock<mutex> l(m);
+        ++en_cola;
+    }
+    hay_tarea.notify_one();
+}
+
+void Pool_tareas::espera() {
+    unique_lock<mutex> l(m);
+    sin_tareas.wait(l,[this]() { return pendientes==0; });
+}
+
+void Pool_tareas::paralelo(int n, const function<void(int)>& f) {
+    // Los trozos se reparten con un contador compartido: cada participante coge el siguiente trozo libre.
+    // Una tarea que empieza cuando ya no quedan trozos acaba sin tocar f, que puede haber dejado de existir
+    if (n<=0) return;
+    struct Estado {
+        atomic<int> siguiente, hechos;
+        mutex m;
+        condition_variable cv;
+    };
+    shared_ptr<Estado> e=make_shared<Estado>();
+    e->siguiente=0;
+    e->hechos=0;
+    int h=trab.size()+1;
+    int trozo=max(1,n/(4*h));
+    int trozos=(n+trozo-1)/trozo;
+    const function<void(int)>* pf=&f;
+    function<void()> participa=[e,pf,n,trozo,trozos]() {
+        int c;
+        // Inv: se han ejecutado los trozos que ha cogido este participante
+        while ((c=e->siguiente++)<trozos) {
+            for (int i=c*trozo; i<min(n,(c+1)*trozo); ++i) (*pf)(i);
+            if (++e->hechos==trozos) {
+                unique_lock<mutex> l(e->m);
+                e->cv.notify_all();
+            }
+        }
+    };
+    for (int i=0; i<min(h-1,trozos-1); ++i) envia(participa);
+    participa();
+    unique_lock<mutex> l(e->m);
+    e->cv.wait(l,[e,trozos]() { return e->hechos==trozos; });
+}
+
+
+//Escritura
+
+void Pool_tareas::imprime_estadisticas(ostream& out) const {
+    double total=nanosegundos(chrono::steady_clock::now()-inicio);
+    out<<"hilos: "<<trab.size()<<endl;
+    // Inv: se han escrito las estadísticas de los hilos anteriores a i
+    for (int i=0; i<trab.size(); ++i) {
+        const Trabajador& t=*trab[i];
+        out<<"hilo "<<i<<": cpu ";
+        if (t.cpu>=0) out<<t.cpu;
+        else out<<"-";
+        out<<" tareas "<<t.tareas<<" robadas "<<t.robadas<<" ocupacion ";
+        out<<(total>0 ? 100*t.ocupado/total : 0)<<"%"<<endl;
+    }
+}
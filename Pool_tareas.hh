@@ -0,0 +1,180 @@
+/** @file Pool_tareas.hh
+    @brief Especificación de la clase Pool_tareas
+*/
+
+#ifndef POOL_TAREAS_HH
+#define POOL_TAREAS_HH
+#ifndef NO_DIAGRAM
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+using namespace std;
+
+
+/** @class Pool_tareas
+    @brief Representa un conjunto fijo de hilos que ejecutan tareas en segundo plano, compartido por todas las
+    etapas paralelas del programa.
+
+    Cada hilo tiene su propia cola de tareas. Las tareas que envía un hilo del pool van a su propia cola, y las
+    que se envían desde fuera se reparten entre las colas por turnos. Cada hilo ejecuta primero las tareas más
+    recientes de su cola y, cuando se queda sin tareas, roba las más antiguas de las colas de los demás hilos.
+    Quien envía las tareas es responsable de saber cuándo han acabado (por ejemplo, marcándolo al final de cada
+    tarea), o puede usar paralelo(), que reparte un bucle entre los hilos y espera a que acabe.
+
+    Opcionalmente, cada hilo se fija a un procesador, recorriendo los procesadores nodo NUMA a nodo NUMA para
+    que los hilos consecutivos compartan memoria. El p.i. lleva la cuenta de las tareas que ejecuta cada hilo,
+    de las que roba y del tiempo que pasa ocupado.
+*/
+
+class Pool_tareas {
+
+    private:
+        /** @brief Cola y estadísticas de un hilo */
+        struct Trabajador {
+            /** @brief Tareas pendientes de empezar */
+            deque<function<void()> > cola;
+            /** @brief Protege la cola */
+            mutex m;
+            /** @brief Procesador al que está fijado el hilo, o -1 */
+            int cpu;
+            /** @brief Tareas ejecutadas y robadas a otros hilos */
+            atomic<long long> tareas, robadas;
+            /** @brief Tiempo ejecutando tareas, en nanosegundos */
+            atomic<long long> ocupado;
+        };
+
+        /** @brief Hilos del pool */
+        vector<thread> hilos;
+
+        /** @brief Cola y estadísticas de cada hilo */
+        vector<unique_ptr<Trabajador> > trab;
+
+        /** @brief Protege los contadores */
+        mutex m;
+
+        /** @brief Avisa a los hilos de que hay tareas o de que deben acabar */
+        condition_variable hay_tarea;
+
+        /** @brief Avisa de que no queda ninguna tarea pendiente ni en curso */
+        condition_variable sin_tareas;
+
+        /** @brief Número de tareas en las colas */
+        int en_cola;
+
+        /** @brief Número de tareas enviadas que no han acabado */
+        int pendientes;
+
+        /** @brief Indica que los hilos deben acabar */
+        bool fin;
+
+        /** @brief Cola a la que va la siguiente tarea enviada desde fuera del pool */
+        atomic<unsigned> turno;
+
+        /** @brief Momento de creación del p.i. */
+        chrono::steady_clock::time_point inicio;
+
+        /** @brief Pool y número de hilo del hilo actual (nulo y -1 fuera de cualquier pool) */
+        static thread_local Pool_tareas* pool_actual;
+        static thread_local int hilo_actual;
+
+            /**
+            @brief Bucle de cada hilo del pool.
+            \pre 0 <= w < num_hilos().
+            \post Ha ejecutado tareas hasta que se ha destruido el p.i.
+            */
+        void trabaja(int w);
+
+            /**
+            @brief Modificadora: Coge una tarea.
+            \pre 0 <= w < num_hilos().
+            \post Si hay alguna tarea en las colas, la ha quitado y la ha dejado en f (la más reciente de la cola
+            de w o, si está vacía, la más antigua de otra cola) y devuelve cierto; robada indica si era de otra cola.
+            */
+        bool coge(int w, function<void()>& f, bool& robada);
+
+            /**
+            @brief Consultora: Procesadores en el orden en que se fijan los hilos.
+            \pre <em>Cierto.</em>
+            \post Devuelve los procesadores agrupados por nodo NUMA (o en orden si no se conocen los nodos).
+            */
+        static vector<int> procesadores();
+
+
+    public:
+
+    //Constructora
+
+            /**
+            @brief Constructora con el número de hilos.
+            \pre <em>Cierto.</em>
+            \post Crea un pool con max(n,1) hilos esperando tareas. Si fijar es cierto, cada hilo se fija a un
+            procesador.
+            */
+        explicit Pool_tareas(int n, bool fijar=false);
+
+
+    //Destructora
+
+            /**
+            @brief Destructora.
+            \post Ha esperado a que acaben todas las tareas enviadas y ha acabado los hilos del p.i.
+            */
+        ~Pool_tareas();
+
+
+    //Consultora
+
+            /**
+            @brief Consultora: Devuelve el número de hilos.
+            \pre <em>Cierto.</em>
+            \post Devuelve el número de hilos del p.i.
+            */
+        int num_hilos() const;
+
+
+    //Modificadoras
+
+            /**
+            @brief Modificadora: Envía una tarea.
+            \pre <em>Cierto.</em>
+            \post La tarea f se ejecutará en uno de los hilos del p.i.
+            */
+        void envia(function<void()> f);
+
+            /**
+            @brief Modificadora: Espera a que acaben todas las tareas.
+            \pre No se llama desde un hilo del p.i.
+            \post No hay ninguna tarea del p.i. pendiente ni en curso.
+            */
+        void espera();
+
+            /**
+            @brief Modificadora: Ejecuta un bucle en paralelo.
+            \pre f(i) y f(j) se pueden ejecutar a la vez para i != j.
+            \post Se ha ejecutado f(i) para cada i de [0...n-1]. Los valores se reparten en trozos consecutivos
+            entre los hilos del p.i. y el hilo que llama, que ejecuta trozos hasta que no queda ninguno sin
+            empezar; por eso se puede llamar desde una tarea del p.i.
+            */
+        void paralelo(int n, const function<void(int)>& f);
+
+
+    //Escritura
+
+            /**
+            @brief Escritura: Imprime las estadísticas de los hilos.
+            \pre <em>Cierto.</em>
+            \post Se ha escrito por el canal out, para cada hilo, el procesador al que está fijado, las tareas que
+            ha ejecutado y robado y el porcentaje del tiempo desde la creación del p.i. que ha estado ocupado.
+            */
+        void imprime_estadisticas(ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,184 @@
+/** @file Registro_especies.cc
+    @brief Código de la clase Registro_especies
+*/
+
+#include "Registro_especies.hh"
+#include <algorithm>
+
+const int Registro_especies::VACIA;
+const int Registro_especies::BORRADA;
+
+//Constructora y destructora
+
+Registro_especies::Registro_especies() {
+    n=0;
+    borradas=0;
+    orden_valido=true;
+}
+
+Registro_especies::~Registro_especies(){}
+
+
+//Consultoras
+
+size_t Registro_especies::hash(const string& id) {
+    size_t h=14695981039346656037ULL;
+    for (int i=0; i<id.size(); ++i) {
+        h^=(unsigned char) id[i];
+        h*=1099511628211ULL;
+    }
+    return h;
+}
+
+int Registro_especies::posicion(const string& id) const {
+    // Sondeo lineal a partir de la posición del hash hasta encontrar id o una posición VACIA
+    if (indice.empty()) return -1;
+    size_t m=indice.size()-1;
+    size_t p=hash(id)&m;
+    // Inv: las posiciones visitadas antes de p no contienen la fila de id
+    while (indice[p]!=VACIA) {
+        if (indice[p]!=BORRADA and especies[indice[p]].consultar_id_especie()==id) return p;
+        p=(p+1)&m;
+    }
+    return -1;
+}
+
+bool Registro_especies::Menor::operator()(int a, int b) const {
+    return (*e)[a].consultar_id_especie()<(*e)[b].consultar_id_especie();
+}
+
+int Registro_especies::buscar(const string& id) const {
+    int p=posicion(id);
+    if (p<0) return -1;
+    return indice[p];
+}
+
+const Especie& Registro_especies::consultar(int f) const {
+    return especies[f];
+}
+
+bool Registro_especies::fila_ocupada(int f) const {
+    return f<ocupada.size() and ocupada[f];
+}
+
+int Registro_especies::num_especies() const {
+    return n;
+}
+
+int Registro_especies::num_filas() const {
+    return especies.size();
+}
+
+void Registro_especies::bytes(size_t& especies, size_t& perfiles) const {
+    especies=this->especies.capacity()*sizeof(Especie)+ocupada.capacity()+indice.capacity()*sizeof(int);
+    {
+        unique_lock<mutex> l(m_orden);
+        especies+=orden_lex.capacity()*sizeof(int);
+    }
+    perfiles=0;
+    for (int f=0; f<this->especies.size(); ++f) {
+        if (ocupada[f]) {
+            especies+=this->especies[f].bytes_gen();
+            perfiles+=this->especies[f].bytes_perfiles();
+        }
+    }
+}
+
+const vector<int>& Registro_especies::orden() const {
+    if (not orden_valido) {
+        unique_lock<mutex> l(m_orden);
+        if (orden_valido) return orden_lex;
+        orden_lex.clear();
+        for (int f=0; f<especies.size(); ++f) {
+            if (ocupada[f]) orden_lex.push_back(f);
+        }
+        Menor menor;
+        menor.e=&especies;
+        sort(orden_lex.begin(),orden_lex.end(),menor);
+        orden_valido=true;
+    }
+    return orden_lex;
+}
+
+
+//Modificadoras
+
+void Registro_especies::reindexa(int cap) {
+    indice.assign(cap,VACIA);
+    borradas=0;
+    size_t m=cap-1;
+    // Inv: las especies de las filas anteriores a f están en el índice
+    for (int f=0; f<especies.size(); ++f) {
+        if (ocupada[f]) {
+            size_t p=hash(especies[f].consultar_id_especie())&m;
+            while (indice[p]!=VACIA) p=(p+1)&m;
+            indice[p]=f;
+        }
+    }
+}
+
+Especie& Registro_especies::modificar(int f) {
+    return especies[f];
+}
+
+void Registro_especies::inserta(int f, Especie&& e) {
+    // El índice se amplía cuando está ocupado (contando las posiciones BORRADA) más de la mitad
+    if (f>=especies.size()) {
+        especies.resize(f+1);
+        ocupada.resize(f+1,false);
+    }
+    especies[f]=move(e);
+    ocupada[f]=true;
+    ++n;
+    if (2*(n+borradas)>indice.size()) {
+        int cap=16;
+        while (cap<4*n) cap*=2;
+        reindexa(cap);
+    }
+    else {
+        size_t m=indice.size()-1;
+        size_t p=hash(especies[f].consultar_id_especie())&m;
+        while (indice[p]!=VACIA and indice[p]!=BORRADA) p=(p+1)&m;
+        if (indice[p]==BORRADA) --borradas;
+        indice[p]=f;
+    }
+    // El orden lexicográfico solo se mantiene si ya era válido
+    if (orden_valido) {
+        Menor menor;
+        menor.e=&especies;
+        orden_lex.insert(upper_bound(orden_lex.begin(),orden_lex.end(),f,menor),f);
+    }
+}
+
+void Registro_especies::elimina(int f) {
+    int p=posicion(especies[f].consultar_id_especie());
+    if (orden_valido) {
+        Menor menor;
+        menor.e=&especies;
+        orden_lex.erase(lower_bound(orden_lex.begin(),orden_lex.end(),f,menor));
+    }
+    indice[p]=BORRADA;
+    ++borradas;
+    especies[f]=Especie();
+    ocupada[f]=false;
+    --n;
+}
+
+void Registro_especies::reserva(int n) {
+    especies.reserve(n);
+    ocupada.reserve(n);
+    int cap=16;
+    while (cap<4*n) cap*=2;
+    if (cap>indice.size()) reindexa(cap);
+}
+
+void Registro_especies::vacia() {
+    especies.clear();
+    ocupada.clear();
+    indice.clear();
+    n=0;
+    borradas=0;
+    orden_lex.clear();
+    // Después de vaciarlo, el orden se calcula de una vez en la siguiente consulta
+    orden_valido=false;
+}
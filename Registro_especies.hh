@@ -0,0 +1,203 @@
+/** @file Registro_especies.hh
+    @brief Especificación de la clase Registro_especies
+*/
+
+#ifndef REGISTRO_ESPECIES_HH
+#define REGISTRO_ESPECIES_HH
+
+#include "Especie.hh"
+#ifndef NO_DIAGRAM
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#endif
+
+
+/** @class Registro_especies
+    @brief Representa un conjunto de especies guardadas en filas consecutivas e indexadas por identificador.
+
+    Las especies se guardan (por movimiento) en un vector, cada una en una fila elegida por quien la inserta
+    (en Cjt_especies, la misma fila que ocupa en la tabla de distancias). Un índice hash de direccionamiento
+    abierto (sondeo lineal) asocia cada identificador a su fila, de forma que las búsquedas cuestan O(1) en
+    promedio. El orden lexicográfico de los identificadores, necesario solo para las operaciones que imprimen,
+    se mantiene aparte y se recalcula únicamente cuando se consulta después de una carga completa.
+
+    Las consultoras se pueden llamar desde varios hilos a la vez, siempre que no haya ninguna modificación en curso.
+*/
+
+class Registro_especies {
+
+    private:
+        /** @brief Especie de cada fila */
+        vector<Especie> especies;
+
+        /** @brief Indica para cada fila si contiene una especie */
+        vector<char> ocupada;
+
+        /** @brief Índice hash: fila de la especie, VACIA o BORRADA. Su tamaño es una potencia de 2 */
+        vector<int> indice;
+
+        /** @brief Número de especies */
+        int n;
+
+        /** @brief Número de posiciones BORRADA del índice */
+        int borradas;
+
+        /** @brief Filas ocupadas en orden lexicográfico de identificador (válido si orden_valido) */
+        mutable vector<int> orden_lex;
+
+        /** @brief Indica si orden_lex está actualizado */
+        mutable atomic<bool> orden_valido;
+
+        /** @brief Protege el recálculo de orden_lex, que pueden pedir varias consultas a la vez */
+        mutable mutex m_orden;
+
+        /** @brief Posición libre del índice */
+        static const int VACIA=-1;
+
+        /** @brief Posición del índice que ha contenido una especie eliminada */
+        static const int BORRADA=-2;
+
+            /**
+            @brief Consultora: Función de hash de un identificador (FNV-1a).
+            \pre <em>Cierto.</em>
+            \post Devuelve el hash de id.
+            */
+        static size_t hash(const string& id);
+
+            /**
+            @brief Consultora: Posición del índice de un identificador.
+            \pre <em>Cierto.</em>
+            \post Devuelve la posición del índice que contiene la fila de id, o -1 si id no está en el p.i.
+            */
+        int posicion(const string& id) const;
+
+            /**
+            @brief Modificadora: Reconstruye el índice.
+            \pre cap es una potencia de 2 mayor que el doble del número de especies.
+            \post El índice del p.i. tiene cap posiciones, contiene todas las especies y ninguna posición BORRADA.
+            */
+        void reindexa(int cap);
+
+            /**
+            @brief Compara dos filas por el identificador de su especie.
+            */
+        struct Menor {
+            const vector<Especie>* e;
+            bool operator()(int a, int b) const;
+        };
+
+
+    public:
+
+    //Constructora
+
+            /**
+            @brief Constructora por defecto.
+            \pre <em>Cierto.</em>
+            \post Crea un registro vacío.
+            */
+        Registro_especies();
+
+
+    //Destructora
+
+            /**
+            @brief Destructora por defecto.
+            */
+        ~Registro_especies();
+
+
+    //Consultoras
+
+            /**
+            @brief Consultora: Busca una especie.
+            \pre <em>Cierto.</em>
+            \post Devuelve la fila de la especie con identificador id, o -1 si no está en el p.i.
+            */
+        int buscar(const string& id) const;
+
+            /**
+            @brief Consultora: Devuelve la especie de una fila.
+            \pre La fila f contiene una especie.
+            \post Devuelve la especie de la fila f del p.i.
+            */
+        const Especie& consultar(int f) const;
+
+            /**
+            @brief Consultora: Indica si una fila contiene una especie.
+            \pre 0 <= f.
+            \post Indica si la fila f del p.i. contiene una especie.
+            */
+        bool fila_ocupada(int f) const;
+
+            /**
+            @brief Consultora: Devuelve el número de especies.
+            \pre <em>Cierto.</em>
+            \post Devuelve el número de especies del p.i.
+            */
+        int num_especies() const;
+
+            /**
+            @brief Consultora: Devuelve el número de filas.
+            \pre <em>Cierto.</em>
+            \post Devuelve uno más que la mayor fila que ha contenido una especie desde la última vez que se vació el p.i.
+            */
+        int num_filas() const;
+
+            /**
+            @brief Consultora: Memoria del registro.
+            \pre <em>Cierto.</em>
+            \post especies es la memoria que ocupan las filas del p.i., su índice y su orden, con los
+            identificadores y los genes; perfiles, la de los perfiles de sus especies (Especie::bytes_perfiles).
+            */
+        void bytes(size_t& especies, size_t& perfiles) const;
+
+            /**
+            @brief Consultora: Devuelve las filas en orden lexicográfico.
+            \pre <em>Cierto.</em>
+            \post Devuelve las filas ocupadas del p.i. ordenadas por el identificador de su especie.
+            */
+        const vector<int>& orden() const;
+
+
+    //Modificadoras
+
+            /**
+            @brief Modificadora: Añade una especie.
+            \pre La fila f no contiene ninguna especie y no hay ninguna especie con el identificador de e en el p.i.
+            \post La especie e (movida) ocupa la fila f del p.i.
+            */
+        void inserta(int f, Especie&& e);
+
+            /**
+            @brief Modificadora: Devuelve la especie de una fila para modificarla.
+            \pre La fila f contiene una especie. No se modifica el identificador de la especie devuelta.
+            \post Devuelve la especie de la fila f del p.i.
+            */
+        Especie& modificar(int f);
+
+            /**
+            @brief Modificadora: Elimina una especie.
+            \pre La fila f contiene una especie.
+            \post La fila f del p.i. queda libre.
+            */
+        void elimina(int f);
+
+            /**
+            @brief Modificadora: Reserva espacio para n filas.
+            \pre n >= 0.
+            \post Las inserciones en las filas [0...n-1] no provocan la reubicación de las especies del p.i.
+            */
+        void reserva(int n);
+
+            /**
+            @brief Modificadora: Vacía el registro.
+            \pre <em>Cierto.</em>
+            \post El p.i. no contiene ninguna especie ni ninguna fila.
+            */
+        void vacia();
+};
+
+#endif
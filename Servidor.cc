@@ -0,0 +1,129 @@
+/** @file Servidor.cc
+    @brief Código de la clase Servidor
+*/
+
+#include "Servidor.hh"
+#include <cerrno>
+#include <cstring>
+#include <streambuf>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+* Canal de un cliente: streambuf con un buffer de lectura y otro de escritura sobre el descriptor
+* de la conexión. La escritura se envía al cliente al vaciar el canal (flush, endl) o al llenarse.
+*/
+class Canal_socket : public streambuf {
+
+    private:
+        int fd;
+        vector<char> entrada;
+        vector<char> salida;
+
+        bool envia(const char* p, size_t n) {
+            // Inv: se han enviado los bytes anteriores a p
+            while (n>0) {
+                ssize_t r=send(fd,p,n,MSG_NOSIGNAL);
+                if (r<=0) return false;
+                p+=r;
+                n-=r;
+            }
+            return true;
+        }
+
+    protected:
+        int_type underflow() {
+            ssize_t r=recv(fd,entrada.data(),entrada.size(),0);
+            if (r<=0) return traits_type::eof();
+            setg(entrada.data(),entrada.data(),entrada.data()+r);
+            return traits_type::to_int_type(*gptr());
+        }
+
+        int_type overflow(int_type c) {
+            if (sync()!=0) return traits_type::eof();
+            if (not traits_type::eq_int_type(c,traits_type::eof())) {
+                *pptr()=traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        int sync() {
+            bool ok=envia(pbase(),pptr()-pbase());
+            setp(salida.data(),salida.data()+salida.size());
+            return ok ? 0 : -1;
+        }
+
+    public:
+        explicit Canal_socket(int fd) : fd(fd), entrada(1<<16), salida(1<<16) {
+            setg(entrada.data(),entrada.data(),entrada.data());
+            setp(salida.data(),salida.data()+salida.size());
+        }
+
+        ~Canal_socket() {
+            sync();
+            close(fd);
+        }
+};
+
+
+//Constructora y destructora
+
+Servidor::Servidor() {
+    fd=-1;
+}
+
+Servidor::~Servidor() {
+    if (fd>=0) {
+        close(fd);
+        unlink(ruta.c_str());
+    }
+}
+
+
+//Modificadoras
+
+bool Servidor::escucha(const string& ruta) {
+    sockaddr_un dir;
+    if (ruta.size()>=sizeof(dir.sun_path)) return false;
+    memset(&dir,0,sizeof(dir));
+    dir.sun_family=AF_UNIX;
+    strcpy(dir.sun_path,ruta.c_str());
+    // Solo se sustituye un socket que ya existía: cualquier otro fichero en la ruta se conserva y es un error
+    struct stat st;
+    if (lstat(ruta.c_str(),&st)==0) {
+        if (not S_ISSOCK(st.st_mode) or unlink(ruta.c_str())!=0) return false;
+    }
+    else if (errno!=ENOENT) return false;
+    fd=socket(AF_UNIX,SOCK_STREAM,0);
+    if (fd<0) return false;
+    if (bind(fd,(sockaddr*) &dir,sizeof(dir))!=0 or listen(fd,64)!=0) {
+        close(fd);
+        fd=-1;
+        return false;
+    }
+    this->ruta=ruta;
+    return true;
+}
+
+void Servidor::atiende(function<void(istream&, ostream&)> sesion) {
+    // Inv: los clientes aceptados hasta ahora se atienden en su propio hilo
+    while (true) {
+        int c=accept(fd,0,0);
+        if (c<0) {
+            if (errno==EINTR or errno==ECONNABORTED) continue;
+            return;
+        }
+        thread([c,sesion]() {
+            Canal_socket canal(c);
+            istream in(&canal);
+            ostream out(&canal);
+            sesion(in,out);
+            out.flush();
+        }).detach();
+    }
+}
@@ -0,0 +1,73 @@
+/** @file Servidor.hh
+    @brief Especificación de la clase Servidor
+*/
+
+#ifndef SERVIDOR_HH
+#define SERVIDOR_HH
+#ifndef NO_DIAGRAM
+#include <functional>
+#include <iostream>
+#include <string>
+#endif
+using namespace std;
+
+
+/** @class Servidor
+    @brief Representa un servidor que atiende sesiones por un socket local (Unix).
+
+    Cada cliente que se conecta al socket se atiende en un hilo propio: lo que envía el cliente llega a la
+    sesión como canal de entrada, y lo que la sesión escribe en su canal de salida se envía al cliente.
+    La sesión es la encargada de sincronizar el acceso a los datos compartidos entre clientes.
+*/
+
+class Servidor {
+
+    private:
+        /** @brief Ruta del socket */
+        string ruta;
+
+        /** @brief Descriptor del socket que escucha (-1 si no escucha) */
+        int fd;
+
+
+    public:
+
+    //Constructora
+
+            /**
+            @brief Constructora por defecto.
+            \pre <em>Cierto.</em>
+            \post Crea un servidor que no escucha.
+            */
+        Servidor();
+
+
+    //Destructora
+
+            /**
+            @brief Destructora.
+            \post Cierra y elimina el socket del p.i., si lo tiene.
+            */
+        ~Servidor();
+
+
+    //Modificadoras
+
+            /**
+            @brief Modificadora: Crea el socket del servidor.
+            \pre El p.i. no escucha.
+            \post Devuelve si se ha podido crear un socket en la ruta (sustituyendo el socket que hubiera) y escuchar
+            en él. Si en la ruta hay un fichero que no es un socket, no se toca y devuelve falso.
+            */
+        bool escucha(const string& ruta);
+
+            /**
+            @brief Modificadora: Atiende a los clientes.
+            \pre El p.i. escucha.
+            \post Acepta clientes indefinidamente (hasta que falla el socket); cada uno se atiende en un hilo que
+            ejecuta sesion con los canales de entrada y salida conectados al cliente.
+            */
+        void atiende(function<void(istream&, ostream&)> sesion);
+};
+
+#endif
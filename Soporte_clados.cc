@@ -0,0 +1,139 @@
+/** @file Soporte_clados.cc
+    @brief Código de la clase Soporte_clados
+*/
+
+#include "Soporte_clados.hh"
+#include <cmath>
+#include <random>
+
+typedef BinTree < pair<string,double> > Arbol_clu;
+
+static void hojas_de(const Arbol_clu& c, vector<string>& h) {
+    // Identificadores de las hojas de c, en el orden del recorrido
+    if (c.value().second==-1) h.push_back(c.value().first);
+    else {
+        hojas_de(c.left(),h);
+        hojas_de(c.right(),h);
+    }
+}
+
+static bool visita(const Arbol_clu& c, const unordered_map<string,int>& num, Soporte_clados::Recorrido& r) {
+    // Añade a r las hojas y los rangos de los nodos internos de c
+    if (c.value().second==-1) {
+        unordered_map<string,int>::const_iterator it=num.find(c.value().first);
+        if (it==num.end()) return false;
+        r.hoja.push_back(it->second);
+        return true;
+    }
+    int i=r.rango.size();
+    r.rango.push_back(make_pair(int(r.hoja.size()),0));
+    if (not visita(c.left(),num,r) or not visita(c.right(),num,r)) return false;
+    r.rango[i].second=r.hoja.size();
+    return true;
+}
+
+//Constructora
+
+Soporte_clados::Soporte_clados(const Arbol_clu& a, uint64_t semilla) {
+    ref=a;
+    hojas_de(a,nombre);
+    int n=nombre.size();
+    mt19937_64 gen(semilla);
+    clave.resize(n);
+    // Inv: se han numerado las hojas anteriores a i
+    for (int i=0; i<n; ++i) {
+        num[nombre[i]]=i;
+        clave[i]=gen();
+    }
+    Recorrido r;
+    recorre(a,r);
+    palabras=(n+63)/64;
+    int m=r.rango.size();
+    bits.assign(size_t(m)*palabras,0);
+    tam.resize(m);
+    // Inv: se han guardado los clados de los nodos internos anteriores a i (en preorden)
+    for (int i=0; i<m; ++i) {
+        int ini=r.rango[i].first;
+        int fin=r.rango[i].second;
+        uint64_t* b=bits.data()+size_t(i)*palabras;
+        for (int t=ini; t<fin; ++t) b[r.hoja[t]/64]|=uint64_t(1)<<(r.hoja[t]%64);
+        tam[i]=fin-ini;
+        por_clave.insert(make_pair(r.x[fin]^r.x[ini],i));
+    }
+    arboles=0;
+    veces.assign(m,0);
+}
+
+
+//Consultoras
+
+bool Soporte_clados::recorre(const Arbol_clu& a, Recorrido& r) const {
+    r.hoja.clear();
+    r.rango.clear();
+    if (not visita(a,num,r)) return false;
+    r.x.resize(r.hoja.size()+1);
+    r.x[0]=0;
+    for (int i=0; i<r.hoja.size(); ++i) r.x[i+1]=r.x[i]^clave[r.hoja[i]];
+    return true;
+}
+
+const vector<string>& Soporte_clados::hojas() const {
+    return nombre;
+}
+
+int Soporte_clados::num_clados() const {
+    return tam.size();
+}
+
+void Soporte_clados::cuenta(const Arbol_clu& a, Recorrido& r, vector<int>& v) const {
+    if (not recorre(a,r)) return;
+    // Inv: se han contado los clados de los nodos internos de a anteriores a i
+    for (int i=0; i<r.rango.size(); ++i) {
+        int ini=r.rango[i].first;
+        int fin=r.rango[i].second;
+        pair<unordered_multimap<uint64_t,int>::const_iterator,unordered_multimap<uint64_t,int>::const_iterator> c=
+            por_clave.equal_range(r.x[fin]^r.x[ini]);
+        bool hallado=false;
+        for (unordered_multimap<uint64_t,int>::const_iterator it=c.first; it!=c.second and not hallado; ++it) {
+            int j=it->second;
+            if (tam[j]==fin-ini) {
+                // Mismo tamaño: es el mismo clado si contiene todas las hojas del rango
+                const uint64_t* b=bits.data()+size_t(j)*palabras;
+                int t=ini;
+                while (t<fin and (b[r.hoja[t]/64]>>(r.hoja[t]%64)&1)) ++t;
+                if (t==fin) {
+                    ++v[j];
+                    hallado=true;
+                }
+            }
+        }
+    }
+}
+
+
+//Modificadora
+
+void Soporte_clados::suma(const vector<int>& v, int n) {
+    for (int i=0; i<v.size(); ++i) veces[i]+=v[i];
+    arboles+=n;
+}
+
+
+//Escritura
+
+void Soporte_clados::imprime(const Arbol_clu& c, int& i, ostream& out) const {
+    if (c.value().second==-1) out<<'['<<c.value().first<<']';
+    else {
+        int s= arboles==0 ? 0 : int(floor(100.0*veces[i]/arboles+0.5));
+        ++i;
+        out<<"[("<<c.value().first<<", "<<c.value().second<<", "<<s<<") ";
+        imprime(c.left(),i,out);
+        imprime(c.right(),i,out);
+        out<<"]";
+    }
+}
+
+void Soporte_clados::imprime(ostream& out) const {
+    int i=0;
+    imprime(ref,i,out);
+}
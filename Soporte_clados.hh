@@ -0,0 +1,146 @@
+/** @file Soporte_clados.hh
+    @brief Especificación de la clase Soporte_clados
+*/
+
+#ifndef SOPORTE_CLADOS_HH
+#define SOPORTE_CLADOS_HH
+#ifndef NO_DIAGRAM
+#include "BinTree.hh"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#endif
+using namespace std;
+
+
+/** @class Soporte_clados
+    @brief Representa la frecuencia con la que los clados de un árbol de referencia aparecen en otros árboles con
+    las mismas hojas (el soporte de cada clado en un <em>bootstrap</em>).
+
+    Un clado es el conjunto de hojas de un subárbol. Cada hoja tiene una clave aleatoria de 64 bits, y la clave de
+    un clado es la o exclusiva de las claves de sus hojas. Al recorrer un árbol, las hojas de cada subárbol son
+    consecutivas en el orden del recorrido, así que con las o exclusivas acumuladas de ese orden la clave de cada
+    clado se obtiene en tiempo constante. Los clados de la referencia se buscan por su clave en una tabla hash y,
+    si coincide, se comprueba el conjunto de hojas con su mapa de bits, de forma que una colisión de claves nunca
+    cuenta un clado que no está.
+
+    Las consultas no modifican el p.i.: varios hilos pueden contar árboles a la vez, cada uno con su propio
+    Recorrido y su propio vector de apariciones, que al final se suman.
+*/
+
+class Soporte_clados {
+
+    public:
+        /** @brief Memoria de trabajo de un recorrido: se reutiliza entre árboles para no reservarla cada vez */
+        struct Recorrido {
+            /** @brief Número de cada hoja, en el orden del recorrido */
+            vector<int> hoja;
+            /** @brief x[i] es la o exclusiva de las claves de las i primeras hojas del recorrido */
+            vector<uint64_t> x;
+            /** @brief Para cada nodo interno, en preorden, la primera y la última hoja más uno de su subárbol */
+            vector<pair<int,int> > rango;
+        };
+
+    private:
+        /** @brief Número de cada hoja de la referencia */
+        unordered_map<string,int> num;
+
+        /** @brief Identificador de cada hoja, por número */
+        vector<string> nombre;
+
+        /** @brief Clave aleatoria de cada hoja */
+        vector<uint64_t> clave;
+
+        /** @brief Árbol de referencia */
+        BinTree<pair<string,double> > ref;
+
+        /** @brief Palabras de 64 bits del mapa de bits de un clado */
+        int palabras;
+
+        /** @brief Mapa de bits de las hojas de cada clado de la referencia (nodos internos en preorden), uno detrás
+        de otro */
+        vector<uint64_t> bits;
+
+        /** @brief Número de hojas de cada clado de la referencia */
+        vector<int> tam;
+
+        /** @brief Clados de la referencia por clave */
+        unordered_multimap<uint64_t,int> por_clave;
+
+        /** @brief Número de árboles contados y en cuántos aparece cada clado de la referencia */
+        int arboles;
+        vector<int> veces;
+
+            /**
+            @brief Consultora: Recorre un árbol.
+            \pre Las hojas de a son hojas de la referencia.
+            \post r contiene las hojas de a en el orden del recorrido, las o exclusivas acumuladas de sus claves y el
+            rango de hojas de cada nodo interno, en preorden. Devuelve falso si alguna hoja de a no es de la referencia.
+            */
+        bool recorre(const BinTree<pair<string,double> >& a, Recorrido& r) const;
+
+            /**
+            @brief Escritura: Imprime un subárbol de la referencia con el soporte de sus clados.
+            \pre c es un subárbol de la referencia; i es el número en preorden de su raíz, si es interna.
+            \post Se ha escrito c por el canal out y i ha avanzado hasta el siguiente nodo interno.
+            */
+        void imprime(const BinTree<pair<string,double> >& c, int& i, ostream& out) const;
+
+    public:
+
+    //Constructora
+            /**
+            @brief Creadora con el árbol de referencia.
+            \pre Las hojas de a (nodos con altura -1) tienen identificadores diferentes.
+            \post El p.i. tiene a como referencia y no ha contado ningún árbol. La semilla determina las claves.
+            */
+        Soporte_clados(const BinTree<pair<string,double> >& a, uint64_t semilla);
+
+
+    //Consultoras
+            /**
+            @brief Consultora: Hojas de la referencia.
+            \pre <em>Cierto.</em>
+            \post Devuelve los identificadores de las hojas de la referencia, en el orden del recorrido.
+            */
+        const vector<string>& hojas() const;
+
+            /**
+            @brief Consultora: Número de clados de la referencia.
+            \pre <em>Cierto.</em>
+            \post Devuelve el número de nodos internos de la referencia.
+            */
+        int num_clados() const;
+
+            /**
+            @brief Consultora: Cuenta los clados de un árbol.
+            \pre a tiene las mismas hojas que la referencia; v tiene num_clados() elementos.
+            \post Se ha sumado 1 a v[i] para cada clado i de la referencia que también es un clado de a. Cuesta
+            O(n) más el tamaño de los clados con la misma clave.
+            */
+        void cuenta(const BinTree<pair<string,double> >& a, Recorrido& r, vector<int>& v) const;
+
+
+    //Modificadora
+            /**
+            @brief Modificadora: Suma las apariciones de varios árboles.
+            \pre v tiene num_clados() elementos y contiene las apariciones de n árboles.
+            \post Los árboles se han añadido a los contados por el p.i.
+            */
+        void suma(const vector<int>& v, int n);
+
+
+    //Escritura
+            /**
+            @brief Escritura: Imprime la referencia con el soporte de cada clado.
+            \pre <em>Cierto.</em>
+            \post Se ha escrito por el canal out el árbol de referencia con el formato de
+            Cjt_clusters::imprime_arbol_filogenetico, y junto a la altura de cada clado el porcentaje de los árboles
+            contados en que aparece: "[(ab, altura, soporte) [a][b]]".
+            */
+        void imprime(ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,426 @@
+/** @file Tabla_distancias.cc
+    @brief Código de la clase Tabla_distancias
+*/
+
+#include "Tabla_distancias.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+const size_t Tabla_distancias::BLOQUE;
+const int Tabla_distancias::MIN_PARALELO;
+
+// Conversión entre la distancia (double) y su representación en cada modo.
+// En coma fija, el valor 65535 corresponde a la distancia 100.
+
+static inline double decodifica(double x) { return x; }
+static inline double decodifica(float x) { return x; }
+static inline double decodifica(uint16_t x) { return x*(100.0/65535); }
+
+static inline void codifica(double d, double& x) { x=d; }
+static inline void codifica(double d, float& x) { x=d; }
+static inline void codifica(double d, uint16_t& x) {
+    double q=d*(65535/100.0)+0.5;
+    if (q<0) q=0;
+    else if (q>65535) q=65535;
+    x=uint16_t(q);
+}
+
+static void error_archivo(const char* op) {
+    // Error irrecuperable del archivo de la tabla
+    cerr<<"ERROR: Tabla_distancias: "<<op<<": "<<strerror(errno)<<endl;
+    exit(1);
+}
+
+template <class T>
+void Tabla_distancias::minimo_columnas(const vector<string>& nombre, int j_ini, int j_fin, bool& hay, T& m,
+                                       int& a, int& b) const {
+    // Recorre la tabla condensada en el orden en que está guardada (columna j, filas i<j).
+    // Los empates se resuelven con el par de identificadores lexicográficamente menor,
+    // igual que el recorrido de la tabla ordenada por identificadores.
+    const T* t=(const T*) datos();
+    hay=false;
+    m=T();
+    const string* ma=0;
+    const string* mb=0;
+    // Inv: m es la distancia mínima entre las filas activas anteriores a j,
+    // y (ma, mb) el menor par de identificadores con distancia m
+    for (int j=j_ini; j<j_fin; ++j) {
+        if (activa[j]) {
+            toca(pos(0,j),pos(0,j)+j);
+            const T* col=&t[pos(0,j)];
+            // Inv: se han comparado las distancias de j con las filas anteriores a i
+            for (int i=0; i<j; ++i) {
+                if (activa[i] and (not hay or col[i]<=m)) {
+                    const string* x=&nombre[i];
+                    const string* y=&nombre[j];
+                    if (*y<*x) swap(x,y);
+                    if (not hay or col[i]<m or *x<*ma or (*x==*ma and *y<*mb)) {
+                        hay=true;
+                        m=col[i];
+                        ma=x;
+                        mb=y;
+                        a=i;
+                        b=j;
+                    }
+                }
+            }
+        }
+    }
+    // Post: m es la distancia mínima del rango y (ma, mb) el menor par a esa distancia
+}
+
+template <class T>
+void Tabla_distancias::minimo_tipo(const vector<string>& nombre, int& a, int& b, double& d, Pool_tareas* pool) const {
+    // Cada trozo de columnas tiene aproximadamente las mismas distancias (la columna j tiene j), y
+    // los mínimos de los trozos se combinan con el mismo criterio, así que el resultado no depende del reparto.
+    // Las tablas en un archivo se recorren en un solo hilo para visitar los bloques en orden
+    bool hay;
+    T m;
+    int p= (pool==0 or fd>=0 or n<MIN_PARALELO) ? 1 : 4*(pool->num_hilos()+1);
+    if (p==1) minimo_columnas(nombre,1,n,hay,m,a,b);
+    else {
+        vector<int> lim(p+1);
+        for (int t=0; t<=p; ++t) lim[t]=max(1,int(n*sqrt(double(t)/p)));
+        lim[p]=n;
+        vector<char> hay_t(p);
+        vector<T> m_t(p);
+        vector<int> a_t(p),b_t(p);
+        pool->paralelo(p,[this,&nombre,&lim,&hay_t,&m_t,&a_t,&b_t](int t) {
+            bool h;
+            minimo_columnas(nombre,lim[t],lim[t+1],h,m_t[t],a_t[t],b_t[t]);
+            hay_t[t]=h;
+        });
+        hay=false;
+        // Inv: (a, b) es el mejor par de los trozos anteriores a t, a distancia m
+        for (int t=0; t<p; ++t) {
+            if (hay_t[t]) {
+                pair<const string&,const string&> x=minmax(nombre[a_t[t]],nombre[b_t[t]]);
+                if (not hay or m_t[t]<m or (m_t[t]==m and x<minmax(nombre[a],nombre[b]))) {
+                    hay=true;
+                    m=m_t[t];
+                    a=a_t[t];
+                    b=b_t[t];
+                }
+            }
+        }
+    }
+    if (nombre[b]<nombre[a]) swap(a,b);
+    d=decodifica(m);
+}
+
+template <class T>
+void Tabla_distancias::fusiona_tipo(int a, int b) {
+    // Recalcula las distancias de la fila a con la media de a y b. Las columnas de a y b
+    // son contiguas; el resto de distancias se visitan en orden creciente de posición,
+    // así que cada bloque se marca solo al entrar en él
+    T* t=(T*) datos();
+    toca(pos(0,a),pos(0,a)+a);
+    toca(pos(0,b),pos(0,b)+b);
+    size_t ba=size_t(-1);
+    size_t bb=size_t(-1);
+    // Inv: las distancias de a con las filas anteriores a c han sido recalculadas
+    for (int c=0; c<n; ++c) {
+        if (activa[c] and c!=a and c!=b) {
+            size_t pa=(c<a) ? pos(c,a) : pos(a,c);
+            size_t pb=(c<b) ? pos(c,b) : pos(b,c);
+            if (c>a and pa*sizeof(T)/BLOQUE!=ba) {
+                ba=pa*sizeof(T)/BLOQUE;
+                toca(pa,pa+1);
+            }
+            if (c>b and pb*sizeof(T)/BLOQUE!=bb) {
+                bb=pb*sizeof(T)/BLOQUE;
+                toca(pb,pb+1);
+            }
+            codifica((decodifica(t[pa])+decodifica(t[pb]))/2, t[pa]);
+        }
+    }
+}
+
+
+//Constructoras y destructora
+
+Tabla_distancias::Tabla_distancias() {
+    modo=DOBLE;
+    n=0;
+    fd=-1;
+    mapa=0;
+    capacidad=0;
+    presupuesto=0;
+    num_residentes=0;
+}
+
+Tabla_distancias::Tabla_distancias(Modo_tabla modo) {
+    this->modo=modo;
+    n=0;
+    fd=-1;
+    mapa=0;
+    capacidad=0;
+    presupuesto=0;
+    num_residentes=0;
+}
+
+Tabla_distancias::Tabla_distancias(const Tabla_distancias& t) {
+    fd=-1;
+    mapa=0;
+    capacidad=0;
+    num_residentes=0;
+    copia(t);
+}
+
+Tabla_distancias& Tabla_distancias::operator=(const Tabla_distancias& t) {
+    if (this!=&t) {
+        cierra_archivo();
+        copia(t);
+    }
+    return *this;
+}
+
+Tabla_distancias::~Tabla_distancias() {
+    cierra_archivo();
+}
+
+
+//Consultoras
+
+size_t Tabla_distancias::pos(int i, int j) {
+    return size_t(j)*(j-1)/2+i;
+}
+
+size_t Tabla_distancias::tam_elem() const {
+    return tam_elem(modo);
+}
+
+size_t Tabla_distancias::tam_elem(Modo_tabla m) {
+    if (m==DOBLE) return sizeof(double);
+    if (m==SIMPLE) return sizeof(float);
+    return sizeof(uint16_t);
+}
+
+char* Tabla_distancias::datos() const {
+    if (fd>=0) return mapa;
+    return const_cast<char*>(mem.data());
+}
+
+void Tabla_distancias::toca(size_t ini, size_t fin) const {
+    // Mantiene residentes como mucho presupuesto bloques: los que se cargan
+    // después de llenar el presupuesto sustituyen a los cargados hace más tiempo.
+    // Los bloques ya residentes se reconocen sin bloquear m_bloques
+    if (fd<0 or ini>=fin) return;
+    size_t te=tam_elem();
+    size_t b=(ini*te)/BLOQUE;
+    size_t b_fin=((fin*te)-1)/BLOQUE;
+    while (b<=b_fin and residente[b].load(memory_order_relaxed)) ++b;
+    if (b>b_fin) return;
+    unique_lock<mutex> l(m_bloques);
+    // Inv: los bloques entre ini*te/BLOQUE y el anterior a b están residentes
+    for (; b<=b_fin; ++b) {
+        if (not residente[b].load(memory_order_relaxed)) {
+            residente[b].store(true,memory_order_relaxed);
+            cola.push_back(b);
+            if (cola.size()>presupuesto) {
+                // Las distancias del bloque se empiezan a escribir al archivo antes de devolverlo
+                size_t v=cola.front();
+                cola.pop_front();
+                residente[v].store(false,memory_order_relaxed);
+                msync(mapa+v*BLOQUE,BLOQUE,MS_ASYNC);
+                madvise(mapa+v*BLOQUE,BLOQUE,MADV_DONTNEED);
+                posix_fadvise(fd,v*BLOQUE,BLOQUE,POSIX_FADV_DONTNEED);
+            }
+        }
+    }
+    num_residentes.store(cola.size(),memory_order_relaxed);
+}
+
+Modo_tabla Tabla_distancias::consultar_modo() const {
+    return modo;
+}
+
+int Tabla_distancias::num_filas() const {
+    return n;
+}
+
+bool Tabla_distancias::fila_activa(int i) const {
+    return activa[i];
+}
+
+double Tabla_distancias::consultar(int i, int j) const {
+    if (j<i) swap(i,j);
+    size_t p=pos(i,j);
+    toca(p,p+1);
+    if (modo==DOBLE) return decodifica(((const double*) datos())[p]);
+    if (modo==SIMPLE) return decodifica(((const float*) datos())[p]);
+    return decodifica(((const uint16_t*) datos())[p]);
+}
+
+void Tabla_distancias::minimo(const vector<string>& nombre, int& a, int& b, double& d, Pool_tareas* pool) const {
+    if (modo==DOBLE) minimo_tipo<double>(nombre,a,b,d,pool);
+    else if (modo==SIMPLE) minimo_tipo<float>(nombre,a,b,d,pool);
+    else minimo_tipo<uint16_t>(nombre,a,b,d,pool);
+}
+
+size_t Tabla_distancias::bytes() const {
+    if (fd>=0) return num_residentes.load(memory_order_relaxed)*BLOQUE;
+    return mem.capacity();
+}
+
+bool Tabla_distancias::en_archivo() const {
+    return fd>=0;
+}
+
+size_t Tabla_distancias::bytes_tabla(int filas, Modo_tabla m) {
+    if (filas<2) return 0;
+    return size_t(filas)*(filas-1)/2*tam_elem(m);
+}
+
+
+//Modificadoras
+
+void Tabla_distancias::redimensiona() {
+    size_t m=(size_t(n)*(n-1)/2)*tam_elem();
+    if (fd<0) mem.resize(m);
+    else if (m>capacidad) {
+        // El archivo crece al doble (como mínimo) para que añadir filas sea amortizado
+        size_t nueva=max(m,2*capacidad);
+        nueva=((nueva+BLOQUE-1)/BLOQUE)*BLOQUE;
+        if (ftruncate(fd,nueva)!=0) error_archivo("ftruncate");
+        void* p;
+        if (mapa==0) p=mmap(0,nueva,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+        else p=mremap(mapa,capacidad,nueva,MREMAP_MAYMOVE);
+        if (p==MAP_FAILED) error_archivo("mmap");
+        mapa=(char*) p;
+        capacidad=nueva;
+        // Los indicadores atómicos no se pueden mover: se copian a un vector nuevo
+        vector<atomic<char> > r(capacidad/BLOQUE);
+        for (size_t b=0; b<residente.size(); ++b) r[b].store(residente[b].load(memory_order_relaxed),memory_order_relaxed);
+        residente.swap(r);
+    }
+}
+
+bool Tabla_distancias::abre_archivo() {
+    // El archivo se desenlaza al crearlo, así desaparece al cerrarlo (o al acabar el programa)
+    string ruta=dir+"/tabla_distancias_XXXXXX";
+    vector<char> plantilla(ruta.begin(),ruta.end());
+    plantilla.push_back('\0');
+    fd=mkstemp(plantilla.data());
+    if (fd<0) return false;
+    unlink(plantilla.data());
+    mapa=0;
+    capacidad=0;
+    return true;
+}
+
+void Tabla_distancias::cierra_archivo() {
+    if (mapa!=0) munmap(mapa,capacidad);
+    if (fd>=0) close(fd);
+    fd=-1;
+    mapa=0;
+    capacidad=0;
+    residente.clear();
+    cola.clear();
+    num_residentes=0;
+}
+
+void Tabla_distancias::copia(const Tabla_distancias& t) {
+    modo=t.modo;
+    n=t.n;
+    activa=t.activa;
+    libres=t.libres;
+    mem=t.mem;
+    dir=t.dir;
+    presupuesto=t.presupuesto;
+    if (t.fd>=0) {
+        if (not abre_archivo()) error_archivo("mkstemp");
+        redimensiona();
+        size_t m=(size_t(n)*(n-1)/2)*tam_elem();
+        size_t te=tam_elem();
+        // Inv: se han copiado los bytes anteriores a i, bloque a bloque
+        for (size_t i=0; i<m; i+=BLOQUE) {
+            size_t l=min(BLOQUE,m-i);
+            t.toca(i/te,(i+l)/te);
+            toca(i/te,(i+l)/te);
+            memcpy(mapa+i,t.mapa+i,l);
+        }
+    }
+}
+
+void Tabla_distancias::modificar(int i, int j, double d) {
+    if (j<i) swap(i,j);
+    size_t p=pos(i,j);
+    toca(p,p+1);
+    if (modo==DOBLE) codifica(d,((double*) datos())[p]);
+    else if (modo==SIMPLE) codifica(d,((float*) datos())[p]);
+    else codifica(d,((uint16_t*) datos())[p]);
+}
+
+int Tabla_distancias::anade_fila() {
+    // Reutiliza una fila libre o añade una al final de la tabla
+    if (not libres.empty()) {
+        int i=libres.back();
+        libres.pop_back();
+        activa[i]=true;
+        return i;
+    }
+    ++n;
+    activa.push_back(true);
+    redimensiona();
+    return n-1;
+}
+
+void Tabla_distancias::elimina_fila(int i) {
+    activa[i]=false;
+    libres.push_back(i);
+}
+
+void Tabla_distancias::fusiona_filas(int a, int b) {
+    if (modo==DOBLE) fusiona_tipo<double>(a,b);
+    else if (modo==SIMPLE) fusiona_tipo<float>(a,b);
+    else fusiona_tipo<uint16_t>(a,b);
+    elimina_fila(b);
+}
+
+void Tabla_distancias::vacia() {
+    n=0;
+    activa.clear();
+    libres.clear();
+    // Devuelve la memoria de la tabla condensada, que puede cambiar de modo o pasar a un archivo
+    vector<char>().swap(mem);
+    if (fd>=0) {
+        // Conserva el archivo, pero sin contenido
+        if (mapa!=0) munmap(mapa,capacidad);
+        if (ftruncate(fd,0)!=0) error_archivo("ftruncate");
+        mapa=0;
+        capacidad=0;
+        residente.clear();
+        cola.clear();
+        num_residentes=0;
+    }
+}
+
+void Tabla_distancias::cambia_modo(Modo_tabla m) {
+    vacia();
+    modo=m;
+}
+
+bool Tabla_distancias::usa_archivo(const string& dir, size_t mb) {
+    vacia();
+    cierra_archivo();
+    this->dir=dir;
+    presupuesto=max(mb,size_t(1));
+    if (not abre_archivo()) {
+        this->dir="";
+        return false;
+    }
+    return true;
+}
+
+void Tabla_distancias::usa_memoria() {
+    cierra_archivo();
+    dir="";
+    vacia();
+}
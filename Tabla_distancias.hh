@@ -0,0 +1,352 @@
+/** @file Tabla_distancias.hh
+    @brief Especificación de la clase Tabla_distancias
+*/
+
+#ifndef TABLA_DISTANCIAS_HH
+#define TABLA_DISTANCIAS_HH
+#ifndef NO_DIAGRAM
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#endif
+#include "Pool_tareas.hh"
+using namespace std;
+
+/** @brief Representación con la que se guardan las distancias de una tabla.
+
+    DOBLE guarda cada distancia en un <em>double</em> (representación original), SIMPLE en un <em>float</em> y
+    CUANTIZADA en un entero de 16 bits en coma fija sobre el intervalo [0,100].
+*/
+enum Modo_tabla { DOBLE, SIMPLE, CUANTIZADA };
+
+
+/** @class Tabla_distancias
+    @brief Representa una tabla de distancias simétrica guardada como matriz triangular condensada.
+
+    Cada elemento de la tabla ocupa una fila (identificada por un entero) y solo se guardan las distancias
+    entre pares de filas diferentes, una única vez por par. La distancia entre las filas i y j (i<j) se guarda
+    en la posición j*(j-1)/2+i, de forma que añadir una fila nueva solo amplía el final de la tabla.
+    Las filas eliminadas quedan libres y se reutilizan en las siguientes inserciones.
+
+    Las distancias se pueden guardar en <em>double</em>, <em>float</em> o en coma fija de 16 bits (ver Modo_tabla),
+    reduciendo a la mitad o a la cuarta parte la memoria (y el ancho de banda) de los recorridos de la tabla.
+
+    Opcionalmente, la tabla condensada se guarda en un archivo temporal proyectado en memoria, dividido en bloques
+    de BLOQUE bytes. Solo se mantienen residentes los últimos bloques visitados (hasta un presupuesto dado) y el
+    resto se escriben al archivo y se devuelven al sistema, de forma que la tabla puede ser mayor que la memoria
+    disponible. Los recorridos de la tabla (minimo, fusiona_filas) visitan los bloques en orden creciente y marcan
+    cada bloque una sola vez. El presupuesto es orientativo: un hilo puede seguir usando un bloque que otro acaba de
+    devolver, y el sistema lo vuelve a cargar del archivo sin perder distancias.
+*/
+
+class Tabla_distancias {
+
+    private:
+        /** @brief Representación de las distancias */
+        Modo_tabla modo;
+
+        /** @brief Número de filas de la tabla (activas o libres) */
+        int n;
+
+        /** @brief Indica para cada fila si está activa */
+        vector<char> activa;
+
+        /** @brief Filas eliminadas que pueden reutilizarse */
+        vector<int> libres;
+
+        /** @brief Tamaño en bytes de los bloques del archivo */
+        static const size_t BLOQUE=1<<20;
+
+        /** @brief Número mínimo de filas para repartir la búsqueda del mínimo entre los hilos de un pool */
+        static const int MIN_PARALELO=512;
+
+        /** @brief Tabla condensada cuando se guarda en memoria */
+        vector<char> mem;
+
+        /** @brief Directorio del archivo de la tabla (vacío si la tabla se guarda en memoria) */
+        string dir;
+
+        /** @brief Descriptor del archivo de la tabla (-1 si la tabla se guarda en memoria) */
+        int fd;
+
+        /** @brief Proyección en memoria del archivo de la tabla */
+        char* mapa;
+
+        /** @brief Tamaño en bytes del archivo y de su proyección */
+        size_t capacidad;
+
+        /** @brief Máximo de bloques del archivo residentes en memoria */
+        size_t presupuesto;
+
+        /** @brief Indica para cada bloque del archivo si está residente (se consulta sin m_bloques) */
+        mutable vector<atomic<char> > residente;
+
+        /** @brief Bloques residentes, en el orden en que se han cargado */
+        mutable deque<size_t> cola;
+
+        /** @brief Número de bloques de cola (se consulta sin m_bloques) */
+        mutable atomic<size_t> num_residentes;
+
+        /** @brief Protege la carga y la devolución de bloques, ya que varios hilos pueden escribir distancias a la vez */
+        mutable mutex m_bloques;
+
+            /**
+            @brief Consultora: Posición de la distancia entre dos filas en la tabla condensada.
+            \pre 0 <= i < j.
+            \post Devuelve la posición de la distancia entre las filas i y j.
+            */
+        static size_t pos(int i, int j);
+
+            /**
+            @brief Consultora: Tamaño en bytes de una distancia.
+            \pre <em>Cierto.</em>
+            \post Devuelve el tamaño en bytes de una distancia en el modo del p.i.
+            */
+        size_t tam_elem() const;
+
+            /**
+            @brief Consultora: Tamaño en bytes de una distancia en un modo.
+            \pre <em>Cierto.</em>
+            \post Devuelve el tamaño en bytes de una distancia en el modo m.
+            */
+        static size_t tam_elem(Modo_tabla m);
+
+            /**
+            @brief Consultora: Inicio de la tabla condensada.
+            \pre <em>Cierto.</em>
+            \post Devuelve la dirección de la primera distancia del p.i. (en memoria o en la proyección del archivo).
+            */
+        char* datos() const;
+
+            /**
+            @brief Consultora: Marca como visitadas las posiciones [ini, fin) de la tabla condensada.
+            \pre ini <= fin <= número de distancias del p.i.
+            \post Si la tabla está en un archivo, los bloques que contienen las posiciones pasan a estar residentes.
+            Si hay más bloques residentes que el presupuesto, se escriben al archivo y se devuelven al sistema los más
+            antiguos. Si todos los bloques ya están residentes, no bloquea m_bloques.
+            */
+        void toca(size_t ini, size_t fin) const;
+
+            /**
+            @brief Modificadora: Ajusta el tamaño de la tabla condensada al número de filas.
+            \pre <em>Cierto.</em>
+            \post La tabla del modo del p.i. tiene espacio para las distancias entre sus n filas.
+            */
+        void redimensiona();
+
+            /**
+            @brief Modificadora: Crea el archivo de la tabla.
+            \pre dir no está vacío y la tabla no tiene archivo.
+            \post Devuelve si se ha podido crear un archivo temporal (anónimo) en dir para el p.i.
+            */
+        bool abre_archivo();
+
+            /**
+            @brief Modificadora: Libera el archivo de la tabla.
+            \pre <em>Cierto.</em>
+            \post El p.i. no tiene archivo ni proyección.
+            */
+        void cierra_archivo();
+
+            /**
+            @brief Modificadora: Copia una tabla.
+            \pre El p.i. no tiene archivo.
+            \post El p.i. es una copia de t, con un archivo propio si t se guarda en un archivo.
+            */
+        void copia(const Tabla_distancias& t);
+
+            /**
+            @brief Consultora: Distancia mínima entre las columnas [j_ini...j_fin-1], guardadas con el tipo T.
+            \pre 0 < j_ini <= j_fin <= n.
+            \post Si hay algún par de filas activas i<j con j en el rango, hay es cierto y (a, b) es el par a menor
+            distancia m del rango, desempatando como minimo() (sin ordenar a y b por nombre); si no, hay es falso.
+            */
+        template <class T>
+        void minimo_columnas(const vector<string>& nombre, int j_ini, int j_fin, bool& hay, T& m, int& a, int& b) const;
+
+            /**
+            @brief Consultora: minimo() para las distancias guardadas con el tipo T.
+            */
+        template <class T>
+        void minimo_tipo(const vector<string>& nombre, int& a, int& b, double& d, Pool_tareas* pool) const;
+
+            /**
+            @brief Modificadora: fusiona_filas() para las distancias guardadas con el tipo T.
+            */
+        template <class T>
+        void fusiona_tipo(int a, int b);
+
+
+    public:
+
+    //Constructoras
+
+            /**
+            @brief Constructora por defecto.
+            \pre <em>Cierto.</em>
+            \post Crea una tabla vacía en modo DOBLE.
+            */
+        Tabla_distancias();
+
+            /**
+            @brief Constructora con modo.
+            \pre <em>Cierto.</em>
+            \post Crea una tabla vacía que guarda las distancias con la representación modo.
+            */
+        explicit Tabla_distancias(Modo_tabla modo);
+
+            /**
+            @brief Constructora de copia.
+            \pre <em>Cierto.</em>
+            \post Crea una copia de t. Si t se guarda en un archivo, la copia tiene un archivo propio en el mismo directorio.
+            */
+        Tabla_distancias(const Tabla_distancias& t);
+
+            /**
+            @brief Asignación.
+            \pre <em>Cierto.</em>
+            \post El p.i. pasa a ser una copia de t (con un archivo propio si t se guarda en un archivo).
+            */
+        Tabla_distancias& operator=(const Tabla_distancias& t);
+
+
+    //Destructora
+
+            /**
+            @brief Destructora.
+            \post Libera el archivo de la tabla, si lo tiene.
+            */
+        ~Tabla_distancias();
+
+
+    //Consultoras
+
+            /**
+            @brief Consultora: Devuelve la representación de las distancias.
+            \pre <em>Cierto.</em>
+            \post Devuelve el modo del p.i.
+            */
+        Modo_tabla consultar_modo() const;
+
+            /**
+            @brief Consultora: Devuelve el número de filas.
+            \pre <em>Cierto.</em>
+            \post Devuelve el número de filas (activas o libres) del p.i.
+            */
+        int num_filas() const;
+
+            /**
+            @brief Consultora: Indica si una fila está activa.
+            \pre 0 <= i < num_filas().
+            \post Indica si la fila i del p.i. está activa.
+            */
+        bool fila_activa(int i) const;
+
+            /**
+            @brief Consultora: Devuelve la distancia entre dos filas.
+            \pre Las filas i y j son diferentes y están activas.
+            \post Devuelve la distancia entre las filas i y j del p.i.
+            */
+        double consultar(int i, int j) const;
+
+            /**
+            @brief Consultora: Encuentra la distancia mínima de la tabla.
+            \pre El p.i. tiene al menos dos filas activas. nombre contiene el identificador de cada fila activa.
+            \post a y b son las filas a menor distancia d, con nombre[a] < nombre[b]. En caso de empate se escoge el
+            par (nombre[a], nombre[b]) lexicográficamente menor. Si hay pool y la tabla está en memoria, las
+            columnas se reparten entre sus hilos.
+            */
+        void minimo(const vector<string>& nombre, int& a, int& b, double& d, Pool_tareas* pool=0) const;
+
+            /**
+            @brief Consultora: Devuelve la memoria ocupada por las distancias.
+            \pre <em>Cierto.</em>
+            \post Devuelve el número de bytes de la tabla condensada del p.i. que ocupan memoria (si se guarda en un 
+            archivo, los de los bloques residentes).
+            */
+        size_t bytes() const;
+
+            /**
+            @brief Consultora: Indica si la tabla se guarda en un archivo.
+            \pre <em>Cierto.</em>
+            \post Indica si las distancias del p.i. se guardan en un archivo proyectado en memoria.
+            */
+        bool en_archivo() const;
+
+            /**
+            @brief Consultora: Memoria de una tabla en memoria.
+            \pre filas >= 0.
+            \post Devuelve los bytes que ocupa la tabla condensada de una tabla en memoria con filas filas y
+            modo m.
+            */
+        static size_t bytes_tabla(int filas, Modo_tabla m);
+
+
+    //Modificadoras
+
+            /**
+            @brief Modificadora: Modifica la distancia entre dos filas.
+            \pre Las filas i y j son diferentes y están activas.
+            \post La distancia entre las filas i y j del p.i. pasa a ser d (redondeada según el modo).
+            */
+        void modificar(int i, int j, double d);
+
+            /**
+            @brief Modificadora: Añade una fila a la tabla.
+            \pre <em>Cierto.</em>
+            \post Devuelve una fila activa nueva del p.i. (reutilizando una fila libre si la hay). Sus distancias
+            están indefinidas.
+            */
+        int anade_fila();
+
+            /**
+            @brief Modificadora: Elimina una fila de la tabla.
+            \pre La fila i está activa.
+            \post La fila i del p.i. pasa a estar libre.
+            */
+        void elimina_fila(int i);
+
+            /**
+            @brief Modificadora: Fusiona dos filas según el algoritmo wpgma.
+            \pre Las filas a y b son diferentes y están activas.
+            \post La distancia de la fila a con cada fila activa c pasa a ser la media de las distancias
+            originales de c con a y con b. La fila b pasa a estar libre.
+            */
+        void fusiona_filas(int a, int b);
+
+            /**
+            @brief Modificadora: Vacía la tabla.
+            \pre <em>Cierto.</em>
+            \post El p.i. no tiene filas y conserva su modo.
+            */
+        void vacia();
+
+            /**
+            @brief Modificadora: Cambia la representación de las distancias.
+            \pre <em>Cierto.</em>
+            \post El p.i. está vacío y guarda las distancias con la representación m (en memoria o en archivo, 
+            igual que antes).
+            */
+        void cambia_modo(Modo_tabla m);
+
+            /**
+            @brief Modificadora: Guarda la tabla en un archivo proyectado en memoria.
+            \pre <em>Cierto.</em>
+            \post El p.i. está vacío. Devuelve si se ha podido crear un archivo temporal en el directorio dir. En caso afirmativo, el p.i.
+            guarda sus distancias en él y mantiene residentes como máximo mb bloques de un MiB (como mínimo uno).
+            */
+        bool usa_archivo(const string& dir, size_t mb);
+
+            /**
+            @brief Modificadora: Guarda la tabla en memoria.
+            \pre <em>Cierto.</em>
+            \post El p.i. está vacío y guarda sus distancias en memoria.
+            */
+        void usa_memoria();
+};
+
+#endif
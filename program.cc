@@ -38,144 +38,752 @@
     trabaja a lo largo de la ejecución.
     Además, este módulo es el encargado de hacer las llamadas a los métodos solicitados y lanzar los mensajes 
     de error en caso de ser necesarios.
+
+    Si se ejecuta como <tt>program.exe --servidor ruta k</tt>, en lugar de leer de la entrada estándar el programa
+    escucha en el socket local ruta y atiende a cada cliente que se conecta como una sesión con los mismos comandos
+    (hasta fin o hasta que el cliente cierra la conexión), todas sobre el mismo conjunto de especies y de clústers.
+    Las sesiones ejecutan a la vez los comandos que solo consultan; los que modifican se ejecutan de uno en uno.
+
+    Todas las etapas paralelas comparten un mismo pool de hilos. Delante de las demás opciones se puede indicar
+    <tt>--hilos n</tt> (número de hilos del pool; por defecto, uno por procesador) y <tt>--fijar_hilos</tt> (fija
+    cada hilo a un procesador, nodo NUMA a nodo NUMA). El comando <tt>estadisticas_pool</tt> escribe las tareas
+    ejecutadas y robadas y la ocupación de cada hilo. Sin presupuesto de memoria, <tt>lee_cjt_especies</tt> lee,
+    calcula los perfiles e inserta las especies en etapas concurrentes, y calcula la tabla a medida que llegan.
+
+    El comando <tt>memoria</tt> escribe los bytes que ocupa cada estructura (especies, perfiles, tablas de distancias,
+    índice de vecinos y árboles), y <tt>presupuesto_memoria mb dir</tt> limita a mb MiB (0: sin límite) la memoria
+    de las especies y las tablas. Si la tabla de un conjunto leído no cabe, se guarda con una representación más
+    compacta o, si no basta, en un archivo en el directorio dir ("-": ninguno); si aun así no cabe, o si no cabe la
+    tabla de los clústers, la operación acaba con un error que indica la memoria estimada.
+
+    El comando <tt>ejecuta_paso_wpgma_delta</tt> ejecuta un paso del algoritmo como <tt>ejecuta_paso_wpgma</tt>, pero
+    solo escribe los clústers fusionados, la altura y la fila del nuevo clúster. El comando <tt>graba_traza fichero</tt>
+    acaba el algoritmo desde los clústers actuales grabando en fichero una traza binaria de todas las fusiones, y
+    <tt>reproduce_traza fichero pasos</tt> recupera a partir de ella los clústers y la tabla después de pasos fusiones.
+    Con <tt>puntos_control fichero pasos</tt>, <tt>ejecuta_paso_clust</tt> graba en segundo plano en fichero el estado
+    de los clústers cada pasos fusiones (0: nunca), y <tt>reanuda_clust fichero</tt> acaba el algoritmo desde el
+    último punto grabado y escribe el mismo árbol que <tt>ejecuta_paso_clust</tt>.
+
+    El comando <tt>cluster_especie id</tt> escribe el clúster actual que contiene la especie id, su número de
+    especies y su altura (-1 si la especie aún no se ha fusionado), sin recorrer los árboles de los clústers.
+
+    El comando <tt>bootstrap replicas semilla</tt> repite replicas veces el algoritmo sobre perfiles remuestreados
+    de las especies del árbol filogenético construido y lo escribe con el porcentaje de réplicas en que aparece
+    cada clado, junto a su altura.
+
+    El comando <tt>corta_arbol altura</tt> escribe los grupos que quedan al cortar los clústers actuales (por ejemplo,
+    el árbol filogenético) a la altura indicada: una línea "id: especies" por grupo. <tt>ejecuta_clust_hasta altura</tt>
+    inicializa los clústers como <tt>ejecuta_paso_clust</tt>, pero deja de fusionar en cuanto la siguiente fusión
+    quedaría por encima de altura, y escribe los mismos grupos sin construir el resto del árbol.
+
+    El comando <tt>alfabeto nombre</tt> (automatico, adn, iupac, proteina, murphy10 o murphy4) escoge el alfabeto con
+    el que se calculan los perfiles de las especies (ver Alfabeto) y los recalcula.
+
+    El comando <tt>verifica_motores semilla n c tolerancia</tt> genera un guion aleatorio de n especies y c comandos,
+    lo ejecuta con la implementación de referencia y con cada motor de la tabla de distancias, y compara las salidas
+    (los números pueden diferir como mucho en tolerancia).
 */
 
 
 #ifndef NO_DIAGRAM 
+#include <cmath>
 #include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
 #endif
 #include "Cjt_especies.hh"
+#include "Servidor.hh"
 
 using namespace std;
 
-int main () {
-  
-  int k;
-  cin>>k; //número de carácteres que se utilizará para generar los subtstrings del gen
-  string op; //operación a ejecutar
+/*
+* Comandos que no modifican el conjunto de especies ni el de clústers: en modo servidor
+* se pueden ejecutar a la vez desde varias sesiones.
+*/
+static const set<string> CONSULTAS = {
+  "obtener_gen", "distancia", "distancia_k", "distancias_lote", "tabla_distancias_k", "vecinos", "k_vecinos", "existe_especie", "existe_lote",
+  "imprime_cjt_especies", "tabla_distancias", "precision_tabla", "imprime_cluster", "estadisticas_pool", "memoria",
+  "cluster_especie", "bootstrap", "corta_arbol"
+};
 
-  Cjt_especies cjt;
-  Cjt_clusters clu;
-  
-  while (cin>>op and op!="fin") {
+/*
+* Argumentos de los comandos: número de palabras fijas y, si el comando acaba con una lista cuya longitud es su
+* primera palabra, número de palabras de cada elemento de la lista. Los comandos que no están no tienen argumentos.
+*/
+static const map<string,pair<int,int> > ARGUMENTOS = {
+  {"lee_cjt_especies", {1,2}}, {"perfiles_k", {1,1}}, {"distancias_lote", {1,2}}, {"existe_lote", {1,1}},
+  {"crea_especie", {2,0}}, {"crea_especie_arbol", {2,0}}, {"obtener_gen", {1,0}}, {"distancia", {2,0}},
+  {"distancia_k", {3,0}}, {"vecinos", {2,0}}, {"k_vecinos", {2,0}}, {"elimina_especie", {1,0}},
+  {"existe_especie", {1,0}}, {"tabla_distancias_k", {1,0}}, {"modo_tabla", {1,0}}, {"motor_tabla", {1,0}},
+  {"alfabeto", {1,0}}, {"tabla_en_disco", {2,0}}, {"inicializa_clusters_k", {1,0}}, {"graba_traza", {1,0}},
+  {"reproduce_traza", {2,0}}, {"imprime_cluster", {1,0}}, {"bootstrap", {2,0}}, {"cluster_especie", {1,0}},
+  {"verifica_motores", {4,0}}, {"presupuesto_memoria", {2,0}}, {"puntos_control", {2,0}},
+  {"reanuda_clust", {1,0}}, {"ejecuta_clust_hasta", {1,0}}, {"corta_arbol", {1,0}}
+};
 
-    if (op=="lee_cjt_especies"){
-  
-      cjt.lee_cjt_especies(k);
+/*
+* Lee del canal in los argumentos del comando op (ver ARGUMENTOS) y los deja en args, separados por espacios.
+* Devuelve falso si el canal se acaba antes.
+*/
+static bool lee_argumentos(const string& op, istream& in, string& args) {
+  args.clear();
+  map<string,pair<int,int> >::const_iterator it=ARGUMENTOS.find(op);
+  if (it==ARGUMENTOS.end()) return true;
+  string p;
+  long long n=0;
+  // Inv: args contiene las palabras fijas anteriores a i
+  for (int i=0; i<it->second.first; ++i) {
+    if (not (in>>p)) return false;
+    if (i==0 and it->second.second>0 and not (istringstream(p)>>n)) n=0;
+    args+=p;
+    args+=' ';
+  }
+  // Inv: args contiene las palabras de la lista anteriores a i
+  for (long long i=0; i<n*it->second.second; ++i) {
+    if (not (in>>p)) return false;
+    args+=p;
+    args+=' ';
+  }
+  return true;
+}
 
-      cout<<"# " <<op<<endl;
+static void verifica_motores(int semilla, int n, int c, double tolerancia, int k, Pool_tareas& pool, ostream& out);
+
+/*
+* Mensaje de error de una operación que no cabe en el presupuesto de memoria de cjt.
+*/
+static string error_memoria(const Cjt_especies& cjt) {
+  ostringstream s;
+  s<<"ERROR: Memoria insuficiente: se necesitan "<<cjt.memoria_estimada()<<" bytes y el presupuesto es de "
+   <<cjt.consultar_presupuesto()<<" bytes.";
+  return s.str();
+}
+
+/*
+* Ejecuta la operación op, leyendo sus parámetros del canal in y escribiendo el resultado
+* (o el mensaje de error) en el canal out.
+*/
+static void ejecuta_comando(const string& op, istream& in, ostream& out, int k, Cjt_especies& cjt, Cjt_clusters& clu,
+                            Pool_tareas& pool) {
+
+  if (op=="lee_cjt_especies"){
+
+    bool ok=cjt.lee_cjt_especies(in,k);
+
+    out<<"# " <<op<<endl;
+    if (not ok) out<<error_memoria(cjt)<<endl;
+  }
+
+  else if (op=="crea_especie"){
+    string id_especie,gen;
+    in>>id_especie>>gen;
+    out << "# "<< op << " " << id_especie << " " << gen<<endl;
+    if (cjt.existe_especie(id_especie)) out<<"ERROR: La especie "<< id_especie << " ya existe."<<endl;
+    else {
+      cjt.crea_especie(Especie(move(id_especie),move(gen),k,cjt.consultar_alfabeto()));
+    }
+  }
+  
+  else if (op=="crea_especie_arbol"){
+    string id_especie,gen;
+    in>>id_especie>>gen;
+    out << "# "<< op << " " << id_especie << " " << gen<<endl;
+    if (cjt.existe_especie(id_especie)) out<<"ERROR: La especie "<< id_especie << " ya existe."<<endl;
+    else if (not clu.arbol_construido()) out<<"ERROR: El arbol filogenetico no esta construido."<<endl;
+    else {
+      cjt.crea_especie(Especie(id_especie,move(gen),k,cjt.consultar_alfabeto()));
+      if (cjt.inserta_en_clusters(clu,id_especie)) clu.imprime_arbol_filogenetico(out);
+      else out<<"ERROR: El arbol filogenetico no corresponde al conjunto de especies.";
+      out<<endl;
     }
+  }
+
+  else if (op=="obtener_gen"){
+    string id_especie;
+    in>>id_especie;
+    out<<"# "<<op<<" "<<id_especie<<endl;
+    if (cjt.existe_especie(id_especie)) out<<cjt.obtener_gen(id_especie)<<endl;
+    else out<<"ERROR: La especie "<<id_especie<< " no existe."<<endl;
+  }
+  
+  else if (op=="distancia"){
+    string id_a, id_b;
+    in>>id_a>>id_b;
+    out<<"# "<<op<<" "<<id_a<<" "<< id_b<<endl;
 
-    else if (op=="crea_especie"){
-      string id_especie,gen;
-      cin>>id_especie>>gen;
-      cout << "# "<< op << " " << id_especie << " " << gen<<endl;
-      if (cjt.existe_especie(id_especie)) cout<<"ERROR: La especie "<< id_especie << " ya existe."<<endl;
+    if (cjt.existe_especie(id_a) and cjt.existe_especie(id_b)) {
+      double d=0;
+      if (id_a==id_b) out<<d;
       else {
-        Especie e (id_especie,gen,k);
-        cjt.crea_especie(e);
+        d = cjt.distancia_cjt(id_a,id_b);
       }
+      out << d << endl;
     }
-    
-    else if (op=="obtener_gen"){
-      string id_especie;
-      cin>>id_especie;
-      cout<<"# "<<op<<" "<<id_especie<<endl;
-      if (cjt.existe_especie(id_especie)) cout<<cjt.obtener_gen(id_especie)<<endl;
-      else cout<<"ERROR: La especie "<<id_especie<< " no existe."<<endl;
+    else if (not cjt.existe_especie(id_a) and not cjt.existe_especie(id_b)) {
+      out << "ERROR: La especie " << id_a <<" y la especie " << id_b << " no existen." <<endl;
     }
-    
-    else if (op=="distancia"){
-      string id_a, id_b;
-      cin>>id_a>>id_b;
-      cout<<"# "<<op<<" "<<id_a<<" "<< id_b<<endl;
-
-      if (cjt.existe_especie(id_a) and cjt.existe_especie(id_b)) {
-        double d=0;
-        if (id_a==id_b) cout<<d;
-        else {
-          d = cjt.distancia_cjt(id_a,id_b);
-        }
-        cout << d << endl;
-      }
-      else if (not cjt.existe_especie(id_a) and not cjt.existe_especie(id_b)) {
-        cout << "ERROR: La especie " << id_a <<" y la especie " << id_b << " no existen." <<endl;
-      }
-      else if (not cjt.existe_especie(id_a)) cout << "ERROR: La especie " <<  id_a << " no existe." << endl;
-      else cout << "ERROR: La especie " << id_b << " no existe." << endl;
+    else if (not cjt.existe_especie(id_a)) out << "ERROR: La especie " <<  id_a << " no existe." << endl;
+    else out << "ERROR: La especie " << id_b << " no existe." << endl;
+  }
+
+  else if (op=="distancia_k"){
+    string id_a, id_b;
+    int kk;
+    in>>id_a>>id_b>>kk;
+    out<<"# "<<op<<" "<<id_a<<" "<<id_b<<" "<<kk<<endl;
+    if (not cjt.existe_especie(id_a) and not cjt.existe_especie(id_b)) {
+      out << "ERROR: La especie " << id_a <<" y la especie " << id_b << " no existen." <<endl;
     }
+    else if (not cjt.existe_especie(id_a)) out << "ERROR: La especie " <<  id_a << " no existe." << endl;
+    else if (not cjt.existe_especie(id_b)) out << "ERROR: La especie " << id_b << " no existe." << endl;
+    else if (not cjt.perfil_disponible(kk)) out << "ERROR: El perfil de k " << kk << " no existe." << endl;
+    else if (id_a==id_b) out << 0 << endl;
+    else out << cjt.distancia_cjt(id_a,id_b,kk) << endl;
+  }
 
-    else if (op=="elimina_especie"){
-      string id_especie;
-      cin >> id_especie;
-      if (cjt.existe_especie(id_especie)) {
-        cout<<"# elimina_especie "<<id_especie<<endl;
-        cjt.elimina_especie(id_especie);
-      } 
-      else {
-        cout<<"# elimina_especie "<<id_especie<<endl;
-        cout << "ERROR: La especie " <<id_especie<< " no existe."<<endl;
-      }
+  else if (op=="vecinos"){
+    string id_especie;
+    double umbral;
+    in>>id_especie>>umbral;
+    out<<"# "<<op<<" "<<id_especie<<" "<<umbral<<endl;
+    if (cjt.existe_especie(id_especie)) cjt.vecinos(id_especie,umbral,out);
+    else out<<"ERROR: La especie "<<id_especie<<" no existe."<<endl;
+  }
+
+  else if (op=="k_vecinos"){
+    string id_especie;
+    int kv;
+    in>>id_especie>>kv;
+    out<<"# "<<op<<" "<<id_especie<<" "<<kv<<endl;
+    if (not cjt.existe_especie(id_especie)) out<<"ERROR: La especie "<<id_especie<<" no existe."<<endl;
+    else if (kv<=0) out<<"ERROR: El numero de vecinos debe ser positivo."<<endl;
+    else cjt.k_vecinos(id_especie,kv,out);
+  }
+
+  else if (op=="perfiles_k"){
+    int n;
+    in>>n;
+    vector<int> ks(n);
+    bool positivos=true;
+    for (int i=0; i<n; ++i) {
+      in>>ks[i];
+      if (ks[i]<=0) positivos=false;
     }
+    out<<"# "<<op<<" "<<n;
+    for (int i=0; i<n; ++i) out<<" "<<ks[i];
+    out<<endl;
+    if (not positivos) out<<"ERROR: Los valores de k deben ser positivos."<<endl;
+    else cjt.perfiles_k(ks);
+  }
 
-    else if (op=="existe_especie"){
-      string id_especie;
-      cin >> id_especie;
-      cout<<"# "<<op<<" "<<id_especie<<endl;
-      if (cjt.existe_especie(id_especie)) cout << "SI"<<endl;
-      else cout << "NO" << endl;
+  else if (op=="distancias_lote"){
+    int n;
+    in>>n;
+    vector<pair<string,string> > pares(n);
+    for (int i=0; i<n; ++i) in>>pares[i].first>>pares[i].second;
+    out<<"# "<<op<<" "<<n<<endl;
+    cjt.distancias_lote(pares,out);
+  }
+
+  else if (op=="elimina_especie"){
+    string id_especie;
+    in >> id_especie;
+    if (cjt.existe_especie(id_especie)) {
+      out<<"# elimina_especie "<<id_especie<<endl;
+      cjt.elimina_especie(id_especie);
     } 
-        
-    else if (op=="imprime_cjt_especies"){
-      cout<<"# "<<op<<endl;
-      cjt.imprime_cjt_especies();
+    else {
+      out<<"# elimina_especie "<<id_especie<<endl;
+      out << "ERROR: La especie " <<id_especie<< " no existe."<<endl;
     }
+  }
 
-    else if (op=="tabla_distancias"){
-      cout<<"# "<<op<<endl;
-      cjt.tabla_distancias();
-    }
+  else if (op=="existe_especie"){
+    string id_especie;
+    in >> id_especie;
+    out<<"# "<<op<<" "<<id_especie<<endl;
+    if (cjt.existe_especie(id_especie)) out << "SI"<<endl;
+    else out << "NO" << endl;
+  } 
+      
+  else if (op=="existe_lote"){
+    int n;
+    in>>n;
+    vector<string> ids(n);
+    for (int i=0; i<n; ++i) in>>ids[i];
+    out<<"# "<<op<<" "<<n<<endl;
+    cjt.existe_lote(ids,out);
+  }
 
-    else if (op=="inicializa_clusters"){
-      cout<<"# "<<op<<endl;
+  else if (op=="imprime_cjt_especies"){
+    out<<"# "<<op<<endl;
+    cjt.imprime_cjt_especies(out);
+  }
+
+  else if (op=="tabla_distancias"){
+    out<<"# "<<op<<endl;
+    cjt.tabla_distancias(out);
+  }
+
+  else if (op=="tabla_distancias_k"){
+    int kk;
+    in>>kk;
+    out<<"# "<<op<<" "<<kk<<endl;
+    if (cjt.perfil_disponible(kk)) cjt.tabla_distancias(out,kk);
+    else out<<"ERROR: El perfil de k "<<kk<<" no existe."<<endl;
+  }
+
+  else if (op=="modo_tabla"){
+    string modo;
+    in>>modo;
+    out<<"# "<<op<<" "<<modo<<endl;
+    if (modo=="doble") cjt.cambia_modo_tabla(DOBLE);
+    else if (modo=="simple") cjt.cambia_modo_tabla(SIMPLE);
+    else if (modo=="cuantizada") cjt.cambia_modo_tabla(CUANTIZADA);
+    else out<<"ERROR: El modo "<<modo<<" no existe."<<endl;
+  }
+
+  else if (op=="motor_tabla"){
+    string motor;
+    in>>motor;
+    out<<"# "<<op<<" "<<motor<<endl;
+    if (motor=="fusion") cjt.cambia_motor_tabla(FUSION);
+    else if (motor=="bloques") cjt.cambia_motor_tabla(BLOQUES);
+    else if (motor=="indice") cjt.cambia_motor_tabla(INDICE);
+    else if (motor=="densa") cjt.cambia_motor_tabla(DENSA);
+    else out<<"ERROR: El motor "<<motor<<" no existe."<<endl;
+  }
+
+  else if (op=="alfabeto"){
+    string nombre;
+    in>>nombre;
+    out<<"# "<<op<<" "<<nombre<<endl;
+    if (nombre=="automatico") cjt.cambia_alfabeto(AUTOMATICO);
+    else if (nombre=="adn") cjt.cambia_alfabeto(ADN);
+    else if (nombre=="iupac") cjt.cambia_alfabeto(IUPAC);
+    else if (nombre=="proteina") cjt.cambia_alfabeto(PROTEINA);
+    else if (nombre=="murphy10") cjt.cambia_alfabeto(MURPHY10);
+    else if (nombre=="murphy4") cjt.cambia_alfabeto(MURPHY4);
+    else out<<"ERROR: El alfabeto "<<nombre<<" no existe."<<endl;
+  }
+
+  else if (op=="tabla_en_disco"){
+    string dir;
+    int mb;
+    in>>dir>>mb;
+    out<<"# "<<op<<" "<<dir<<" "<<mb<<endl;
+    if (mb<=0) out<<"ERROR: El presupuesto debe ser positivo."<<endl;
+    else if (not cjt.tabla_en_disco(dir,mb)) out<<"ERROR: No se puede crear la tabla en "<<dir<<"."<<endl;
+  }
+
+  else if (op=="tabla_en_memoria"){
+    out<<"# "<<op<<endl;
+    cjt.tabla_en_memoria();
+  }
+
+  else if (op=="precision_tabla"){
+    out<<"# "<<op<<endl;
+    cjt.precision_tabla(out);
+  }
+
+  else if (op=="inicializa_clusters"){
+    out<<"# "<<op<<endl;
+    clu=Cjt_clusters();
+    if (cjt.inicializa_clusters(clu)) clu.imprime_tab_distancias(out);
+    else out<<error_memoria(cjt)<<endl;
+
+  }
+   
+  else if (op=="inicializa_clusters_k"){
+    int kk;
+    in>>kk;
+    out<<"# "<<op<<" "<<kk<<endl;
+    if (cjt.perfil_disponible(kk)) {
       clu=Cjt_clusters();
-      cjt.inicializa_clusters(clu);
-      clu.imprime_tab_distancias();
+      if (cjt.inicializa_clusters(clu,kk)) clu.imprime_tab_distancias(out);
+      else out<<error_memoria(cjt)<<endl;
+    }
+    else out<<"ERROR: El perfil de k "<<kk<<" no existe."<<endl;
+  }
+   
+  else if (op=="ejecuta_paso_wpgma"){
+    out<<"# "<<op<<endl;
+    if (clu.apto_para_wpgma()) {
+      clu.ejecuta_paso_wpgma(out);
+    }
+    else {
+      out<<"ERROR: num_clusters <= 1"<<endl;
+    }
+  }
+
+  else if (op=="ejecuta_paso_wpgma_delta"){
+    out<<"# "<<op<<endl;
+    if (clu.apto_para_wpgma()) clu.ejecuta_paso_wpgma_delta(out);
+    else out<<"ERROR: num_clusters <= 1"<<endl;
+  }
+
+  else if (op=="graba_traza"){
+    string fichero;
+    in>>fichero;
+    out<<"# "<<op<<" "<<fichero<<endl;
+    if (clu.arbol_vacio()) out<<"ERROR: El conjunto de clusters es vacio.";
+    else if (not clu.graba_traza(fichero)) out<<"ERROR: No se puede escribir "<<fichero<<".";
+    else clu.imprime_arbol_filogenetico(out);
+    out<<endl;
+  }
 
+  else if (op=="reproduce_traza"){
+    string fichero;
+    int pasos;
+    in>>fichero>>pasos;
+    out<<"# "<<op<<" "<<fichero<<" "<<pasos<<endl;
+    if (pasos<0) out<<"ERROR: Los parametros no pueden ser negativos."<<endl;
+    else if (not clu.reproduce_traza(fichero,pasos)) out<<"ERROR: La traza "<<fichero<<" no es valida."<<endl;
+    else {
+      clu.usa_pool(pool);
+      clu.imprime_tab_distancias(out);
     }
-     
-    else if (op=="ejecuta_paso_wpgma"){
-      cout<<"# "<<op<<endl;
-      if (clu.apto_para_wpgma()) {
-        clu.ejecuta_paso_wpgma();
-      }
+  }
+  
+  else if (op=="compara_arbol"){
+    out<<"# "<<op<<endl;
+    if (not clu.arbol_construido()) out<<"ERROR: El arbol filogenetico no esta construido."<<endl;
+    else {
+      Cjt_clusters ref;
+      vector<pair<string,double> > fusiones;
+      if (not cjt.inicializa_clusters(ref)) out<<error_memoria(cjt)<<endl;
       else {
-        cout<<"ERROR: num_clusters <= 1"<<endl;
+        ref.ejecuta_clustering(fusiones);
+        if (ref.arbol_construido()) clu.compara_arbol(ref,out);
+        else out<<"ERROR: El conjunto de clusters es vacio."<<endl;
       }
     }
-    
-    else if (op=="imprime_cluster"){
-      string id_especie;
-      cin >> id_especie;
-      cout<<"# "<<op<<" "<<id_especie<<endl;
-      if (clu.existe_cluster(id_especie)) {
-        clu.imprime_cluster(id_especie);
-        cout<<endl;
-      }
-      else cout<< "ERROR: El cluster " <<id_especie<< " no existe."<<endl;
+  }
 
+  else if (op=="imprime_cluster"){
+    string id_especie;
+    in >> id_especie;
+    out<<"# "<<op<<" "<<id_especie<<endl;
+    if (clu.existe_cluster(id_especie)) {
+      clu.imprime_cluster(id_especie,out);
+      out<<endl;
     }
+    else out<< "ERROR: El cluster " <<id_especie<< " no existe."<<endl;
 
-    else if (op=="ejecuta_paso_clust"){
-      cout<<"# "<<op<<endl;
-      clu=Cjt_clusters();
-      cjt.inicializa_clusters(clu);
-      if (clu.arbol_vacio()) cout<<"ERROR: El conjunto de clusters es vacio.";
-      else {
-        clu.imprime_arbol_filogenetico();
-      }
-      cout<<endl;
+  }
+
+  else if (op=="bootstrap"){
+    int replicas;
+    unsigned semilla;
+    in>>replicas>>semilla;
+    out<<"# "<<op<<" "<<replicas<<" "<<semilla<<endl;
+    if (replicas<0) out<<"ERROR: Los parametros no pueden ser negativos."<<endl;
+    else if (not clu.arbol_construido()) out<<"ERROR: El arbol filogenetico no esta construido."<<endl;
+    else {
+      if (not cjt.bootstrap(clu,replicas,semilla,out)) out<<"ERROR: El arbol filogenetico no corresponde al conjunto de especies.";
+      out<<endl;
+    }
+  }
+
+  else if (op=="cluster_especie"){
+    string id_especie, id;
+    int n;
+    double h;
+    in >> id_especie;
+    out<<"# "<<op<<" "<<id_especie<<endl;
+    if (clu.cluster_de(id_especie,id,n,h)) {
+      clu.imprime_cluster(id,out);
+      out<<endl;
+      out<<"tamano: "<<n<<endl;
+      out<<"altura: "<<h<<endl;
+    }
+    else out<<"ERROR: La especie "<<id_especie<<" no esta en ningun cluster."<<endl;
+  }
+
+  else if (op=="verifica_motores"){
+    int semilla,n,c;
+    double tolerancia;
+    in>>semilla>>n>>c>>tolerancia;
+    out<<"# "<<op<<" "<<semilla<<" "<<n<<" "<<c<<" "<<tolerancia<<endl;
+    if (n<0 or c<0 or tolerancia<0) out<<"ERROR: Los parametros no pueden ser negativos."<<endl;
+    else verifica_motores(semilla,n,c,tolerancia,k,pool,out);
+  }
+
+  else if (op=="presupuesto_memoria"){
+    int mb;
+    string dir;
+    in>>mb>>dir;
+    out<<"# "<<op<<" "<<mb<<" "<<dir<<endl;
+    if (mb<0) out<<"ERROR: Los parametros no pueden ser negativos."<<endl;
+    else cjt.fija_presupuesto(mb, dir=="-" ? "" : dir);
+  }
+
+  else if (op=="memoria"){
+    out<<"# "<<op<<endl;
+    cjt.memoria(out,clu);
+  }
+
+  else if (op=="estadisticas_pool"){
+    out<<"# "<<op<<endl;
+    pool.imprime_estadisticas(out);
+  }
+
+  else if (op=="ejecuta_paso_clust"){
+    out<<"# "<<op<<endl;
+    // Los puntos de control programados se conservan
+    string control=clu.consultar_fichero_control();
+    int pasos=clu.consultar_pasos_control();
+    clu=Cjt_clusters();
+    clu.fija_puntos_control(control,pasos);
+    if (not cjt.inicializa_clusters(clu)) out<<error_memoria(cjt);
+    else if (clu.arbol_vacio()) out<<"ERROR: El conjunto de clusters es vacio.";
+    else {
+      clu.imprime_arbol_filogenetico(out);
+      if (not clu.control_correcto()) out<<endl<<"ERROR: No se puede escribir "<<control<<".";
+    }
+    out<<endl;
+  }
+
+  else if (op=="puntos_control"){
+    string fichero;
+    int pasos;
+    in>>fichero>>pasos;
+    out<<"# "<<op<<" "<<fichero<<" "<<pasos<<endl;
+    if (pasos<0) out<<"ERROR: Los parametros no pueden ser negativos."<<endl;
+    else if (not clu.fija_puntos_control(fichero,pasos)) out<<"ERROR: No se puede escribir "<<fichero<<"."<<endl;
+  }
+
+  else if (op=="reanuda_clust"){
+    string fichero;
+    in>>fichero;
+    out<<"# "<<op<<" "<<fichero<<endl;
+    if (not clu.reanuda_control(fichero)) out<<"ERROR: El punto de control "<<fichero<<" no es valido.";
+    else {
+      clu.imprime_arbol_filogenetico(out);
+      if (not clu.control_correcto()) out<<endl<<"ERROR: No se puede escribir "<<clu.consultar_fichero_control()<<".";
+    }
+    out<<endl;
+  }
+
+  else if (op=="ejecuta_clust_hasta"){
+    double altura;
+    in>>altura;
+    out<<"# "<<op<<" "<<altura<<endl;
+    clu=Cjt_clusters();
+    if (not cjt.inicializa_clusters(clu)) out<<error_memoria(cjt)<<endl;
+    else if (clu.arbol_vacio()) out<<"ERROR: El conjunto de clusters es vacio."<<endl;
+    else {
+      clu.ejecuta_clustering_hasta(altura);
+      clu.corta_arbol(altura,out);
+    }
+  }
+
+  else if (op=="corta_arbol"){
+    double altura;
+    in>>altura;
+    out<<"# "<<op<<" "<<altura<<endl;
+    if (clu.arbol_vacio()) out<<"ERROR: El conjunto de clusters es vacio."<<endl;
+    else clu.corta_arbol(altura,out);
+  }
+  out<<endl;
+}
+
+/*
+* Ejecuta las operaciones del canal in hasta fin o hasta que se acaba el canal. Las consultas
+* se ejecutan con el cerrojo rw compartido y el resto con el cerrojo en exclusiva.
+*/
+static void sesion(istream& in, ostream& out, int k, Cjt_especies& cjt, Cjt_clusters& clu, Pool_tareas& pool,
+                   shared_timed_mutex& rw) {
+  string op; //operación a ejecutar
+  string args;
+  while (in>>op and op!="fin") {
+    // Los argumentos se leen antes de coger el cerrojo: un cliente lento no bloquea a las demás sesiones
+    if (not lee_argumentos(op,in,args)) return;
+    istringstream cmd(args);
+    if (CONSULTAS.count(op)) {
+      shared_lock<shared_timed_mutex> l(rw);
+      ejecuta_comando(op,cmd,out,k,cjt,clu,pool);
+    }
+    else {
+      unique_lock<shared_timed_mutex> l(rw);
+      ejecuta_comando(op,cmd,out,k,cjt,clu,pool);
+    }
+  }
+}
+
+/*
+* Escribe en out un guion de comandos aleatorio (sin el k inicial): un conjunto de n especies y c comandos
+* que crean y eliminan especies, consultan distancias y la tabla y construyen el árbol. Los genes se
+* obtienen mutando unos pocos genes base, para que haya distancias repetidas y se pongan a prueba los empates.
+*/
+static void genera_guion(int semilla, int n, int c, int k, ostream& out) {
+  mt19937 gen(semilla);
+  const string letras="ACGT";
+  vector<string> base(max(1,n/4+1));
+  for (int i=0; i<base.size(); ++i) {
+    int l=k+uniform_int_distribution<int>(0,16)(gen);
+    for (int j=0; j<l; ++j) base[i]+=letras[gen()%4];
+  }
+  // Gen nuevo: un gen base con algunas letras cambiadas
+  auto nuevo_gen=[&]() {
+    string g=base[gen()%base.size()];
+    int cambios=uniform_int_distribution<int>(0,2)(gen);
+    for (int j=0; j<cambios; ++j) g[gen()%g.size()]=letras[gen()%4];
+    return g;
+  };
+  vector<string> ids;
+  int siguiente=0;
+  auto nuevo_id=[&]() { return "v"+to_string(100000+siguiente++); };
+  out<<"lee_cjt_especies "<<n<<endl;
+  for (int i=0; i<n; ++i) {
+    ids.push_back(nuevo_id());
+    out<<ids.back()<<" "<<nuevo_gen()<<endl;
+  }
+  // Inv: se han escrito los comandos anteriores a i; ids contiene las especies existentes (y alguna eliminada)
+  for (int i=0; i<c; ++i) {
+    int t=gen()%10;
+    string a= ids.empty() ? nuevo_id() : ids[gen()%ids.size()];
+    string b= ids.empty() ? nuevo_id() : ids[gen()%ids.size()];
+    if (t<=1) {
+      ids.push_back(nuevo_id());
+      out<<"crea_especie "<<ids.back()<<" "<<nuevo_gen()<<endl;
+    }
+    else if (t==2) out<<"elimina_especie "<<a<<endl;
+    else if (t==3) out<<"distancia "<<a<<" "<<b<<endl;
+    else if (t==4) out<<"tabla_distancias"<<endl;
+    else if (t==5) out<<"inicializa_clusters"<<endl;
+    else if (t==6) out<<"ejecuta_paso_wpgma"<<endl;
+    else if (t==7) out<<"imprime_cluster "<<a<<endl;
+    else if (t==8) out<<"ejecuta_paso_clust"<<endl;
+    else out<<"imprime_cjt_especies"<<endl;
+  }
+  out<<"fin"<<endl;
+}
+
+/*
+* Separa de una palabra los delimitadores ("(", ")", "[", "]", ",") del principio y del final.
+*/
+static string nucleo(const string& x, string& delim) {
+  int i=0;
+  int j=x.size();
+  while (i<j and string("([").find(x[i])!=string::npos) ++i;
+  while (j>i and string(")],").find(x[j-1])!=string::npos) --j;
+  delim=x.substr(0,i)+" "+x.substr(j);
+  return x.substr(i,j-i);
+}
+
+/*
+* Indica si dos líneas son iguales, salvo que los números (también entre delimitadores) pueden diferir en tolerancia.
+*/
+static bool lineas_iguales(const string& a, const string& b, double tolerancia) {
+  if (a==b) return true;
+  if (tolerancia==0) return false;
+  istringstream sa(a),sb(b);
+  string x,y;
+  while (sa>>x) {
+    if (not (sb>>y)) return false;
+    if (x!=y) {
+      string dx,dy;
+      string nx=nucleo(x,dx);
+      string ny=nucleo(y,dy);
+      char* fx;
+      char* fy;
+      double vx=strtod(nx.c_str(),&fx);
+      double vy=strtod(ny.c_str(),&fy);
+      if (dx!=dy or nx.empty() or ny.empty() or *fx!='\0' or *fy!='\0' or not (fabs(vx-vy)<=tolerancia)) return false;
     }
-    cout<<endl;
   }
-}
\ No newline at end of file
+  return not (sb>>y);
+}
+
+/*
+* Ejecuta el guion con un conjunto de especies y de clústers nuevos, con el motor m y, si pool no es nulo,
+* con los cálculos paralelos en pool; devuelve las líneas escritas.
+*/
+static vector<string> ejecuta_guion(const string& guion, int k, Motor_tabla m, Pool_tareas* pool, Pool_tareas& pool_cmd) {
+  Cjt_especies cjt;
+  Cjt_clusters clu;
+  if (pool!=0) cjt.usa_pool(*pool);
+  cjt.cambia_motor_tabla(m);
+  istringstream in(guion);
+  ostringstream out;
+  string op;
+  while (in>>op and op!="fin") ejecuta_comando(op,in,out,k,cjt,clu,pool_cmd);
+  vector<string> lineas;
+  istringstream res(out.str());
+  string l;
+  while (getline(res,l)) lineas.push_back(l);
+  return lineas;
+}
+
+/*
+* Ejecuta un guion aleatorio con la implementación de referencia (motor de fusión, sin pool) y con cada
+* motor en el pool, y escribe en out si sus salidas coinciden o la primera línea en la que difieren.
+*/
+static void verifica_motores(int semilla, int n, int c, double tolerancia, int k, Pool_tareas& pool, ostream& out) {
+  // Las líneas que difieren se escriben como mucho con este número de caracteres
+  const int LARGO_LINEA=200;
+  ostringstream guion;
+  genera_guion(semilla,n,c,k,guion);
+  vector<string> ref=ejecuta_guion(guion.str(),k,FUSION,0,pool);
+  out<<"lineas_referencia: "<<ref.size()<<endl;
+  const Motor_tabla motores[4]={FUSION,BLOQUES,INDICE,DENSA};
+  const string nombres[4]={"fusion","bloques","indice","densa"};
+  // Inv: se han comparado los motores anteriores a i
+  for (int i=0; i<4; ++i) {
+    vector<string> res=ejecuta_guion(guion.str(),k,motores[i],&pool,pool);
+    int l=0;
+    while (l<ref.size() and l<res.size() and lineas_iguales(ref[l],res[l],tolerancia)) ++l;
+    out<<"motor "<<nombres[i]<<": ";
+    if (l==ref.size() and l==res.size()) out<<"OK"<<endl;
+    else {
+      out<<"difiere en la linea "<<l+1<<endl;
+      out<<"  referencia: "<<(l<ref.size() ? ref[l].substr(0,LARGO_LINEA) : "(fin)")<<endl;
+      out<<"  motor:      "<<(l<res.size() ? res[l].substr(0,LARGO_LINEA) : "(fin)")<<endl;
+    }
+  }
+}
+
+int main (int argc, char* argv[]) {
+  
+  int k; //número de carácteres que se utilizará para generar los subtstrings del gen
+  int hilos=thread::hardware_concurrency(); //hilos del pool
+  bool fijar=false; //indica si cada hilo del pool se fija a un procesador
+  int arg=1;
+  // Inv: se han tratado las opciones de argv[1...arg-1]
+  while (arg<argc) {
+    string opcion=argv[arg];
+    if (opcion=="--hilos" and arg+1<argc) {
+      hilos=stoi(argv[arg+1]);
+      arg+=2;
+    }
+    else if (opcion=="--fijar_hilos") {
+      fijar=true;
+      ++arg;
+    }
+    else break;
+  }
+
+  Pool_tareas pool(hilos,fijar);
+  Cjt_especies cjt;
+  Cjt_clusters clu;
+  cjt.usa_pool(pool);
+  shared_timed_mutex rw;
+
+  if (argc-arg==3 and string(argv[arg])=="--servidor") {
+    k=stoi(argv[arg+2]);
+    Servidor servidor;
+    if (not servidor.escucha(argv[arg+1])) {
+      cerr<<"ERROR: No se puede escuchar en "<<argv[arg+1]<<"."<<endl;
+      return 1;
+    }
+    servidor.atiende([&](istream& in, ostream& out) { sesion(in,out,k,cjt,clu,pool,rw); });
+    return 1;
+  }
+
+  cin>>k;
+  sesion(cin,cout,k,cjt,clu,pool,rw);
+}
@@ -0,0 +1,102 @@
+/** @file prueba_asignaciones.cc
+    @brief Prueba de las asignaciones de memoria de la lectura de especies.
+
+    Comprueba que leer n especies solo añade O(n) asignaciones de memoria a las de calcular sus perfiles: para genes
+    aleatorios de dos largos, cuenta las asignaciones de construir las especies sueltas y las de leerlas con
+    Cjt_especies::lee_cjt_especies (con la lectura de referencia y con la lectura en cadena), y compara las que añade
+    la lectura por especie. Se prueba con genes de ADN (perfiles empaquetados) y con genes en minúsculas (perfiles de
+    texto, con un nodo por k-mero): si la lectura copiara los perfiles, las asignaciones que añade crecerían con el
+    número de k-meros de los genes.
+
+    Uso: <tt>prueba_asignaciones.exe [semilla [n]]</tt> (por defecto, 1 y 100). Acaba con 1 si las asignaciones
+    crecen con los k-meros.
+*/
+
+#ifndef NO_DIAGRAM
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <thread>
+#endif
+#include "Cjt_especies.hh"
+
+using namespace std;
+
+/*
+* Número de llamadas a operator new de todo el programa (de cualquier hilo). Como la de la biblioteca, la versión
+* que cuenta reserva con malloc, así que las versiones de operator delete de la biblioteca (que liberan con free)
+* siguen sirviendo. No se expande en línea: si no, el compilador ve el malloc emparejado con operator delete y lo
+* avisa como un error.
+*/
+static atomic<long long> asignaciones(0);
+
+__attribute__((noinline)) void* operator new(size_t n) {
+  asignaciones.fetch_add(1,memory_order_relaxed);
+  void* p=malloc(n==0 ? 1 : n);
+  if (p==0) throw bad_alloc();
+  return p;
+}
+
+int main(int argc, char* argv[]) {
+  int semilla= argc>1 ? atoi(argv[1]) : 1;
+  int n= argc>2 ? atoi(argv[2]) : 100;
+  // Con k = 8 casi todos los k-meros de un gen aleatorio son diferentes
+  const int K=8;
+  // Asignaciones por especie que puede añadir la lectura de los genes largos respecto a la de los cortos
+  // (el canal amplía el gen a medida que lo lee)
+  const double COTA_EXTRA=8;
+  const int largos[2]={100,1000};
+  const string letras[2]={"ACGT","acgt"};
+  const string alfabetos[2]={"adn","texto"};
+  const Motor_tabla motores[2]={FUSION,BLOQUES};
+  const string nombres[2]={"fusion","bloques"};
+  Pool_tareas pool(max(1,int(thread::hardware_concurrency())));
+  mt19937 gen(semilla);
+  int m=max(n,1);
+  bool ok=true;
+  // Inv: se han medido los alfabetos anteriores a a
+  for (int a=0; a<2; ++a) {
+    double extra[2][2];
+    // Inv: se han medido los largos anteriores a l
+    for (int l=0; l<2; ++l) {
+      vector<string> id(n),g(n);
+      ostringstream texto;
+      texto<<n<<endl;
+      for (int i=0; i<n; ++i) {
+        id[i]="v"+to_string(100000+i);
+        for (int j=0; j<largos[l]; ++j) g[i]+=letras[a][gen()%4];
+        texto<<id[i]<<" "<<g[i]<<endl;
+      }
+      long long perfiles;
+      {
+        vector<Especie> e;
+        e.reserve(n);
+        long long ini=asignaciones;
+        for (int i=0; i<n; ++i) e.push_back(Especie(id[i],g[i],K));
+        perfiles=asignaciones-ini;
+      }
+      cout<<"genes de "<<largos[l]<<" ("<<alfabetos[a]<<"): perfiles "<<double(perfiles)/m<<" por especie";
+      for (int t=0; t<2; ++t) {
+        long long ini;
+        {
+          Cjt_especies cjt;
+          cjt.usa_pool(pool);
+          cjt.cambia_motor_tabla(motores[t]);
+          istringstream in(texto.str());
+          ini=asignaciones;
+          cjt.lee_cjt_especies(in,K);
+          // La destructora espera a las tareas de la tabla
+        }
+        extra[l][t]=double(asignaciones-ini-perfiles)/m;
+        cout<<", extra "<<nombres[t]<<" "<<extra[l][t];
+      }
+      cout<<endl;
+    }
+    for (int t=0; t<2; ++t) ok= ok and extra[1][t]<=extra[0][t]+COTA_EXTRA;
+  }
+  cout<<"asignaciones: "<<(ok ? "OK" : "crecen con los k-meros")<<endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+/** @file prueba_diccionario.cc
+    @brief Prueba del diccionario de códigos de Perfiles_compactos.
+
+    Compacta perfiles aleatorios por bloques con un diccionario compartido (como la lectura en cadena) y comprueba
+    que todas las distancias, dentro de cada bloque y entre bloques, son idénticas a las de Especie::distancia con
+    la fusión, con el índice invertido y con la matriz densa de los bloques. Se
+    prueba con genes de ADN (el diccionario busca por código empaquetado y rehace su tabla varias veces) y con
+    bloques que mezclan ADN, IUPAC y texto (el diccionario pasa a buscar por texto conservando los códigos que ya
+    había dado). Escribe OK o el primer par que falla, y acaba con 1 si alguno falla.
+*/
+
+#ifndef NO_DIAGRAM
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#endif
+#include "Especie.hh"
+#include "Perfiles_compactos.hh"
+
+using namespace std;
+
+/*
+* Genes aleatorios de n especies: cada gen tiene entre 1 y largo carácteres de letras[i % letras.size()] y
+* empieza, la mitad de las veces, con un trozo de base (para que compartan substrings).
+*/
+static vector<Especie> especies(mt19937& gen, int n, int largo, int k, const vector<string>& letras) {
+    string base;
+    for (int j=0; j<largo; ++j) base+=letras[0][gen()%letras[0].size()];
+    vector<Especie> e;
+    e.reserve(n);
+    for (int i=0; i<n; ++i) {
+        const string& l=letras[i%letras.size()];
+        int m=1+gen()%largo;
+        string g= gen()%2==0 ? base.substr(0,m/2) : "";
+        while (g.size()<m) g+=l[gen()%l.size()];
+        e.push_back(Especie("e"+to_string(i),g,k));
+    }
+    return e;
+}
+
+/*
+* Compacta los perfiles de e por bloques de b con un solo diccionario (con índice invertido y matriz densa) y compara
+* todas las distancias de los tres núcleos con las de Especie::distancia. Devuelve si coinciden todas; si no, escribe
+* el primer par que falla.
+*/
+static bool prueba(const string& nombre, const vector<Especie>& e, int b) {
+    int n=e.size();
+    Perfiles_compactos::Diccionario codigo;
+    vector<shared_ptr<Perfiles_compactos> > bloque;
+    for (int c=0; c*b<n; ++c) {
+        vector<const Perfil*> p;
+        for (int i=c*b; i<min(n,(c+1)*b); ++i) p.push_back(&e[i].consultar_kmer());
+        bloque.push_back(make_shared<Perfiles_compactos>());
+        bloque.back()->construye(p,codigo);
+        bloque.back()->indexa();
+        bloque.back()->densifica(Perfiles_compactos::max_bytes_densa());
+    }
+    const string nucleos[3]={"fusion","indice","densa"};
+    bool ok=true;
+    int fi=0, fj=0, fn=0;
+    double fd=0;
+    // Inv: se han comparado los pares de los bloques anteriores a c
+    for (int c=0; c<bloque.size() and ok; ++c) {
+        // Inv: se han comparado los pares del bloque c con los núcleos anteriores a u
+        for (int u=0; u<3 and ok; ++u) {
+            function<void(int,int,double)> compara=[&](int i, int j, double d) {
+                // Los genes más cortos que k no tienen substrings: su distancia es NaN en los dos cálculos
+                double r=e[i].distancia(e[j]);
+                if (ok and d!=r and not (isnan(d) and isnan(r))) {
+                    ok=false;
+                    fi=i;
+                    fj=j;
+                    fn=u;
+                    fd=d;
+                }
+            };
+            for (int a=0; a<c; ++a) {
+                function<void(int,int,double)> f=[&compara,b,c,a](int i, int j, double d) { compara(c*b+i,a*b+j,d); };
+                if (u==0) bloque[c]->distancias(*bloque[a],f);
+                else if (u==1) bloque[c]->distancias_indice(*bloque[a],f);
+                else bloque[c]->distancias_densa(*bloque[a],f);
+            }
+            int m=bloque[c]->num_perfiles();
+            function<void(int,int,double)> f=[&compara,b,c](int i, int j, double d) { compara(c*b+i,c*b+j,d); };
+            if (u==0) bloque[c]->distancias(0,m,0,m,f);
+            else if (u==1) bloque[c]->distancias_indice(0,m,f);
+            else bloque[c]->distancias_densa(0,m,f);
+        }
+    }
+    cout<<nombre<<": ";
+    if (ok) cout<<"OK"<<endl;
+    else cout<<"falla ("<<nucleos[fn]<<") "<<e[fi].consultar_id_especie()<<" "<<e[fj].consultar_id_especie()<<" ("
+             <<fd<<" en lugar de "<<e[fi].distancia(e[fj])<<")"<<endl;
+    return ok;
+}
+
+int main() {
+    mt19937 gen(1);
+    bool ok=true;
+    ok= prueba("adn",especies(gen,200,400,8,{"ACGT"}),32) and ok;
+    ok= prueba("adn k=1",especies(gen,50,40,1,{"ACGT"}),7) and ok;
+    ok= prueba("mezcla",especies(gen,150,200,5,{"ACGT","ACGTN","acgtx"}),32) and ok;
+    ok= prueba("texto",especies(gen,60,200,5,{"acgtx"}),16) and ok;
+    return ok ? 0 : 1;
+}